@@ -1,6 +1,8 @@
 #!/usr/bin/env python3
 
 from tree import TreeNode
+import heapq
+import itertools
 import random
 
 
@@ -30,6 +32,58 @@ class OrderedTree:
             for data in a:
                 self.avl_insert(data)
 
+    @staticmethod
+    def is_sorted(data):
+        return all(a <= b for a, b in zip(data, itertools.islice(data, 1, None)))
+
+    @staticmethod
+    def build_balanced(data, lo, hi):
+        """A perfectly balanced tree of data[lo:hi], which must be
+        sorted: the middle element at the top and each half the same
+        way below it.  That's a valid AVL tree, made in O(n)."""
+        if lo >= hi:
+            return None
+        mid = (lo + hi) // 2
+        node = TreeNode(data[mid],
+                        OrderedTree.build_balanced(data, lo, mid),
+                        OrderedTree.build_balanced(data, mid + 1, hi))
+        node.update_height()
+        return node
+
+    @classmethod
+    def from_sorted(cls, data):
+        """A tree of data, which must already be sorted, in O(n)."""
+        ret = cls()
+        ret.bulk_insert(data)
+        return ret
+
+    def bulk_insert(self, data):
+        """Inserts a sorted batch by merging it with what's already in
+        the tree and building it again, in O(n + m) rather than
+        m avl_inserts.  As with avl_insert, an element equal to one
+        already there ends up after it."""
+        data = list(data)
+        if not OrderedTree.is_sorted(data):
+            raise ValueError("bulk_insert needs sorted data")
+        if self.tree is None:
+            merged = data
+        else:
+            merged = list(heapq.merge(self._in_order(), data))
+        self.tree = OrderedTree.build_balanced(merged, 0, len(merged))
+
+    def _in_order(self):
+        # Not TreeNode's __iter__, which checks the whole tree is well
+        # formed at every node.
+        stack = []
+        node = self.tree
+        while stack or node is not None:
+            while node is not None:
+                stack.append(node)
+                node = node.left
+            node = stack.pop()
+            yield node.data
+            node = node.right
+
     def avl_insert(self, data):
         def avl_insert_internal(node):
             if node is None:
@@ -135,6 +189,44 @@ def full_test():
     assert test.is_ordered()
     test.assert_correct_balance()
 
+    bulk_testing()
+
+
+def bulk_testing():
+    test = OrderedTree.from_sorted(range(1000))
+    # Perfectly balanced: 1000 fits in 10 levels.
+    assert test.tree.height == 10
+    assert list(test.tree) == list(range(1000))
+    test.assert_correct_balance()
+    assert OrderedTree.from_sorted([]).tree is None
+    try:
+        OrderedTree.from_sorted([1, 3, 2])
+        assert False
+    except ValueError:
+        pass
+
+    # Merging the odd numbers into the evens.
+    test = OrderedTree.from_sorted(range(0, 200, 2))
+    test.bulk_insert(range(1, 300, 2))
+    assert list(test.tree) == sorted(list(range(0, 200, 2)) +
+                                     list(range(1, 300, 2)))
+    assert 299 in test and 298 not in test
+    test.assert_correct_balance()
+
+    # Repeats are kept, as avl_insert keeps them.
+    test = OrderedTree([1, 2, 2, 3])
+    test.bulk_insert([2, 4])
+    assert list(test.tree) == [1, 2, 2, 2, 3, 4]
+    test.assert_correct_balance()
+
+    # The constructor still inserts one at a time, sorted or not, so
+    # the shapes avl_testing checks are the ones avl_insert makes.
+    test = OrderedTree(range(1, 8))
+    assert test.tree.data == 4
+    test = OrderedTree([5, 1, 4], [2, 3])
+    assert list(test.tree) == [1, 2, 3, 4, 5]
+    test.assert_correct_balance()
+
 
 if __name__ == "__main__":
     full_test()
@@ -0,0 +1,568 @@
+#ifndef BPLUS_TREE_HPP
+#define BPLUS_TREE_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "pool.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// An ordered map kept as a B+-tree, for when the index is big enough
+// that OrderedTree's cache miss per level is what a lookup costs.
+//
+// Rather than one key per node, each node is NodeBytes (four cache
+// lines by default) of keys: an inner node holds as many separator
+// keys as fit next to their child pointers, and a leaf as many keys
+// and values.  With int keys that's a fanout of about 20, so a tree
+// of 100M keys is six or seven levels rather than OrderedTree's 30
+// or so, and each level is a handful of neighbouring cache lines the
+// prefetcher can stream in.
+//
+// Inside a node we don't binary search (which branches unpredictably
+// on every step).  For arithmetic keys with the default std::less we
+// count how many keys are smaller.  With 32-bit ints, floats and
+// doubles that is done 128 bits of keys at a time, with SSE2 (or
+// NEON) compares whose results are turned into a bit per key and
+// counted; other arithmetic keys get a plain branch-free loop, and
+// everything else std::lower_bound.
+//
+// The keys live in the leaves, which are linked left to right, so
+// iterating (or a range scan from lower_bound) just walks along the
+// leaves and never goes back up the tree.
+//
+// Erase is lazy: it takes the key out of its leaf but never merges
+// or rebalances nodes, so a leaf can end up empty (iteration skips
+// those).  That's the usual trade for an index that mostly grows:
+// the tree is never any deeper than it was at its largest, and
+// clear() gives everything back.
+template <class K, class V, class Compare = std::less<K>, size_t NodeBytes = 256>
+class BPlusTree
+{
+    // The common header: how many keys the node has.
+    struct Node
+    {
+        uint16_t count = 0;
+    };
+
+    // Room for the header (padded) and a next pointer.
+    static constexpr size_t header = 16;
+
+public:
+    static constexpr size_t leaf_keys =
+        std::max<size_t>(4, (NodeBytes - header) / (sizeof(K) + sizeof(V)));
+    static constexpr size_t inner_keys =
+        std::max<size_t>(4, (NodeBytes - header) / (sizeof(K) + sizeof(void *)));
+    static_assert(leaf_keys <= UINT16_MAX && inner_keys <= UINT16_MAX,
+                  "NodeBytes too big: a node's key count has to fit Node::count");
+
+private:
+    // Nodes start on a cache line, so a node never straddles more
+    // lines than it has to.
+    struct alignas(64) Leaf : Node
+    {
+        Leaf *next = nullptr;
+        K keys[leaf_keys];
+        V values[leaf_keys];
+    };
+
+    // children[i] has the keys from keys[i - 1] up to (but not
+    // including) keys[i].
+    struct alignas(64) Inner : Node
+    {
+        K keys[inner_keys];
+        Node *children[inner_keys + 1];
+    };
+
+    // Every split at least halves a node, so the tree can't get
+    // deeper than this.
+    static constexpr size_t max_depth = 64;
+
+    static constexpr bool branch_free = std::is_arithmetic_v<K> &&
+                                        (std::is_same_v<Compare, std::less<K>> ||
+                                         std::is_same_v<Compare, std::less<>>);
+
+public:
+    // Whether searching a node uses the explicit vector compares.
+    static constexpr bool simd_search =
+#if defined(__SSE2__) || (defined(__ARM_NEON) && defined(__aarch64__))
+        branch_free && (std::is_same_v<K, int32_t> || std::is_same_v<K, float> ||
+                        std::is_same_v<K, double>);
+#else
+        false;
+#endif
+
+    // Dereferences to a (key, value) pair of references, since keys
+    // and values are kept apart in a leaf.
+    template <bool Const>
+    class Iterator
+    {
+        friend class BPlusTree;
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using iterator_concept = std::forward_iterator_tag;
+        using value_type = std::pair<K, V>;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::pair<const K &, std::conditional_t<Const, const V &, V &>>;
+
+        Iterator() {}
+        Iterator(Leaf *leaf, size_t at) : leaf(leaf), at((uint16_t)at) { skip_empty(); }
+        operator Iterator<true>() const { return Iterator<true>(leaf, at); }
+
+        reference operator*() const { return reference(leaf->keys[at], leaf->values[at]); }
+        const K &key() const { return leaf->keys[at]; }
+        std::conditional_t<Const, const V &, V &> value() const { return leaf->values[at]; }
+
+        Iterator &operator++()
+        {
+            ++at;
+            skip_empty();
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            auto ret = *this;
+            ++*this;
+            return ret;
+        }
+        bool operator==(const Iterator &other) const
+        {
+            return leaf == other.leaf && at == other.at;
+        }
+
+    private:
+        // Off the end of a leaf (or in an empty one), move on to the
+        // next one that has something in it.
+        void skip_empty()
+        {
+            while (leaf && at == leaf->count)
+            {
+                leaf = leaf->next;
+                at = 0;
+            }
+        }
+
+        Leaf *leaf = nullptr;
+        uint16_t at = 0;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    BPlusTree() {}
+
+    BPlusTree(const BPlusTree &other) : _less(other._less)
+    {
+        for (auto [key, value] : other)
+            insert(key, value);
+    }
+
+    BPlusTree &operator=(const BPlusTree &other)
+    {
+        if (&other == this)
+            return *this;
+        clear();
+        _less = other._less;
+        for (auto [key, value] : other)
+            insert(key, value);
+        return *this;
+    }
+
+    BPlusTree(BPlusTree &&other) noexcept
+        : _leaves(std::move(other._leaves)),
+          _inners(std::move(other._inners)),
+          _root(std::exchange(other._root, nullptr)),
+          _first(std::exchange(other._first, nullptr)),
+          _depth(std::exchange(other._depth, 0)),
+          _size(std::exchange(other._size, 0)),
+          _less(std::move(other._less))
+    {
+    }
+
+    BPlusTree &operator=(BPlusTree &&other) noexcept
+    {
+        if (&other == this)
+            return *this;
+        clear();
+        _leaves = std::move(other._leaves);
+        _inners = std::move(other._inners);
+        _root = std::exchange(other._root, nullptr);
+        _first = std::exchange(other._first, nullptr);
+        _depth = std::exchange(other._depth, 0);
+        _size = std::exchange(other._size, 0);
+        _less = std::move(other._less);
+        return *this;
+    }
+
+    ~BPlusTree() { clear(); }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    // How many levels of inner nodes there are above the leaves.
+    size_t depth() const { return _depth; }
+
+    // Returns whether it went in (false if key was already there, in
+    // which case the old value stays).
+    bool insert(const K &key, const V &value)
+    {
+        auto before = _size;
+        auto [leaf, at] = find_or_insert(key);
+        if (_size != before)
+            leaf->values[at] = value;
+        return _size != before;
+    }
+
+    // The value for key, inserting a default one if there isn't one.
+    V &operator[](const K &key)
+    {
+        auto [leaf, at] = find_or_insert(key);
+        return leaf->values[at];
+    }
+
+    V &at(const K &key)
+    {
+        auto it = find(key);
+        if (it == end())
+            throw std::out_of_range("Key not found");
+        return it.value();
+    }
+
+    const V &at(const K &key) const
+    {
+        auto it = find(key);
+        if (it == end())
+            throw std::out_of_range("Key not found");
+        return it.value();
+    }
+
+    bool contains(const K &key) const { return find(key) != end(); }
+
+    iterator find(const K &key) { return exact(key); }
+    const_iterator find(const K &key) const { return exact(key); }
+
+    // The first entry whose key is not less than key, and the first
+    // one whose key is greater: a range scan is from one to the
+    // other.
+    iterator lower_bound(const K &key) { return bound(key, false); }
+    const_iterator lower_bound(const K &key) const { return bound(key, false); }
+    iterator upper_bound(const K &key) { return bound(key, true); }
+    const_iterator upper_bound(const K &key) const { return bound(key, true); }
+
+    // Lazy: see the top.  Returns how many it removed (0 or 1).
+    size_t erase(const K &key)
+    {
+        auto it = exact(key);
+        if (it == end())
+            return 0;
+        auto leaf = it.leaf;
+        std::move(leaf->keys + it.at + 1, leaf->keys + leaf->count, leaf->keys + it.at);
+        std::move(leaf->values + it.at + 1, leaf->values + leaf->count, leaf->values + it.at);
+        leaf->count--;
+        _size--;
+        return 1;
+    }
+
+    void clear()
+    {
+        if (_root)
+            destroy(_root, _depth);
+        _leaves.reset();
+        _inners.reset();
+        _root = _first = nullptr;
+        _depth = 0;
+        _size = 0;
+    }
+
+    iterator begin() { return iterator(_first, 0); }
+    iterator end() { return iterator(); }
+    const_iterator begin() const { return const_iterator(_first, 0); }
+    const_iterator end() const { return const_iterator(); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+private:
+    // How many of the first count keys are less than key (or, with
+    // or_equal, not greater than it).
+    size_t position(const K *keys, size_t count, const K &key, bool or_equal) const
+    {
+        if constexpr (simd_search)
+        {
+            constexpr size_t lanes = 16 / sizeof(K);
+            size_t ret = 0;
+            size_t i = 0;
+            for (; i + lanes <= count; i += lanes)
+                ret += (size_t)std::popcount(below(keys + i, key, or_equal));
+            for (; i < count; ++i)
+                ret += or_equal ? keys[i] <= key : keys[i] < key;
+            return ret;
+        }
+        else if constexpr (branch_free)
+        {
+            size_t ret = 0;
+            if (or_equal)
+            {
+                for (size_t i = 0; i < count; ++i)
+                    ret += keys[i] <= key;
+            }
+            else
+            {
+                for (size_t i = 0; i < count; ++i)
+                    ret += keys[i] < key;
+            }
+            return ret;
+        }
+        else
+        {
+            if (or_equal)
+                return (size_t)(std::upper_bound(keys, keys + count, key, _less) - keys);
+            return (size_t)(std::lower_bound(keys, keys + count, key, _less) - keys);
+        }
+    }
+
+#if defined(__SSE2__)
+    // A bit for each of the 128 bits' worth of keys at k that is less
+    // than key (or, with or_equal, not greater).
+    static unsigned below(const K *k, K key, bool or_equal)
+    {
+        if constexpr (std::is_same_v<K, double>)
+        {
+            auto keys = _mm_loadu_pd(k);
+            auto with = _mm_set1_pd(key);
+            return (unsigned)_mm_movemask_pd(or_equal ? _mm_cmple_pd(keys, with)
+                                                      : _mm_cmplt_pd(keys, with));
+        }
+        else if constexpr (std::is_same_v<K, float>)
+        {
+            auto keys = _mm_loadu_ps(k);
+            auto with = _mm_set1_ps(key);
+            return (unsigned)_mm_movemask_ps(or_equal ? _mm_cmple_ps(keys, with)
+                                                      : _mm_cmplt_ps(keys, with));
+        }
+        else
+        {
+            auto keys = _mm_loadu_si128(reinterpret_cast<const __m128i *>(k));
+            auto with = _mm_set1_epi32(key);
+            // SSE2 has no <= for ints, but k <= key is !(k > key).
+            if (or_equal)
+                return (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(keys, with))) ^ 0xfu;
+            return (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(keys, with)));
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    // As above.  NEON has no movemask, so each all-ones lane of the
+    // compare keeps its own bit of a mask, and adding the lanes up
+    // puts the bits together.
+    static unsigned below(const K *k, K key, bool or_equal)
+    {
+        if constexpr (std::is_same_v<K, double>)
+        {
+            auto keys = vld1q_f64(k);
+            auto with = vdupq_n_f64(key);
+            auto hits = or_equal ? vcleq_f64(keys, with) : vcltq_f64(keys, with);
+            const uint64_t bits[2] = {1, 2};
+            return (unsigned)vaddvq_u64(vandq_u64(hits, vld1q_u64(bits)));
+        }
+        else
+        {
+            uint32x4_t hits;
+            if constexpr (std::is_same_v<K, float>)
+            {
+                auto keys = vld1q_f32(k);
+                auto with = vdupq_n_f32(key);
+                hits = or_equal ? vcleq_f32(keys, with) : vcltq_f32(keys, with);
+            }
+            else
+            {
+                auto keys = vld1q_s32(k);
+                auto with = vdupq_n_s32(key);
+                hits = or_equal ? vcleq_s32(keys, with) : vcltq_s32(keys, with);
+            }
+            const uint32_t bits[4] = {1, 2, 4, 8};
+            return vaddvq_u32(vandq_u32(hits, vld1q_u32(bits)));
+        }
+    }
+#endif
+
+    // Which child of inner the key belongs in.
+    size_t child_for(const Inner *inner, const K &key) const
+    {
+        return position(inner->keys, inner->count, key, true);
+    }
+
+    Leaf *leaf_for(const K &key) const
+    {
+        auto node = _root;
+        for (size_t level = 0; level < _depth; ++level)
+        {
+            auto inner = static_cast<Inner *>(node);
+            node = inner->children[child_for(inner, key)];
+        }
+        return static_cast<Leaf *>(node);
+    }
+
+    iterator exact(const K &key) const
+    {
+        if (!_root)
+            return iterator();
+        auto leaf = leaf_for(key);
+        auto at = position(leaf->keys, leaf->count, key, false);
+        if (at < leaf->count && !_less(key, leaf->keys[at]))
+            return iterator(leaf, at);
+        return iterator();
+    }
+
+    iterator bound(const K &key, bool upper) const
+    {
+        if (!_root)
+            return iterator();
+        auto leaf = leaf_for(key);
+        return iterator(leaf, position(leaf->keys, leaf->count, key, upper));
+    }
+
+    // Where key is, putting it (with a default value) there if it
+    // isn't yet.
+    std::pair<Leaf *, size_t> find_or_insert(const K &key)
+    {
+        if (!_root)
+            _root = _first = _leaves.make();
+
+        // The way down, so that splits can be passed back up.
+        Inner *path[max_depth];
+        size_t slots[max_depth];
+        auto node = _root;
+        for (size_t level = 0; level < _depth; ++level)
+        {
+            auto inner = static_cast<Inner *>(node);
+            path[level] = inner;
+            slots[level] = child_for(inner, key);
+            node = inner->children[slots[level]];
+        }
+
+        auto leaf = static_cast<Leaf *>(node);
+        auto at = position(leaf->keys, leaf->count, key, false);
+        if (at < leaf->count && !_less(key, leaf->keys[at]))
+            return {leaf, at};
+
+        if (leaf->count == leaf_keys)
+        {
+            // Move the top half to a new leaf, and tell the parent.
+            auto right = _leaves.make();
+            auto half = leaf_keys / 2;
+            std::move(leaf->keys + half, leaf->keys + leaf_keys, right->keys);
+            std::move(leaf->values + half, leaf->values + leaf_keys, right->values);
+            right->count = (uint16_t)(leaf_keys - half);
+            leaf->count = (uint16_t)half;
+            right->next = leaf->next;
+            leaf->next = right;
+            insert_up(path, slots, _depth, right->keys[0], right);
+            if (at > half)
+            {
+                leaf = right;
+                at -= half;
+            }
+        }
+
+        std::move_backward(leaf->keys + at, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+        std::move_backward(leaf->values + at, leaf->values + leaf->count,
+                           leaf->values + leaf->count + 1);
+        leaf->keys[at] = key;
+        leaf->values[at] = V();
+        leaf->count++;
+        _size++;
+        return {leaf, at};
+    }
+
+    // A node at this level split, and right (starting at key) goes
+    // after it in path[level - 1].  Which can split in turn, and so on
+    // up to the root.
+    void insert_up(Inner **path, size_t *slots, size_t level, K key, Node *right)
+    {
+        while (level > 0)
+        {
+            auto inner = path[level - 1];
+            auto at = slots[level - 1];
+            if (inner->count < inner_keys)
+            {
+                insert_child(inner, at, key, right);
+                return;
+            }
+            // Split: the middle key moves up rather than being copied,
+            // since inner keys are only signposts.
+            auto sibling = _inners.make();
+            auto half = inner_keys / 2;
+            K middle = inner->keys[half];
+            std::move(inner->keys + half + 1, inner->keys + inner_keys, sibling->keys);
+            std::copy(inner->children + half + 1, inner->children + inner_keys + 1,
+                      sibling->children);
+            sibling->count = (uint16_t)(inner_keys - half - 1);
+            inner->count = (uint16_t)half;
+            if (at <= half)
+                insert_child(inner, at, key, right);
+            else
+                insert_child(sibling, at - half - 1, key, right);
+            key = std::move(middle);
+            right = sibling;
+            level--;
+        }
+
+        // The root split: the tree grows a level.
+        auto root = _inners.make();
+        root->keys[0] = std::move(key);
+        root->children[0] = _root;
+        root->children[1] = right;
+        root->count = 1;
+        _root = root;
+        _depth++;
+    }
+
+    // Puts right (and the key it starts at) just after children[at].
+    static void insert_child(Inner *inner, size_t at, const K &key, Node *right)
+    {
+        std::move_backward(inner->keys + at, inner->keys + inner->count,
+                           inner->keys + inner->count + 1);
+        std::copy_backward(inner->children + at + 1, inner->children + inner->count + 1,
+                           inner->children + inner->count + 2);
+        inner->keys[at] = key;
+        inner->children[at + 1] = right;
+        inner->count++;
+    }
+
+    // Runs the destructors, which the pools won't.
+    void destroy(Node *node, size_t level)
+    {
+        if constexpr (!std::is_trivially_destructible_v<K> || !std::is_trivially_destructible_v<V>)
+        {
+            if (level == 0)
+            {
+                static_cast<Leaf *>(node)->~Leaf();
+                return;
+            }
+            auto inner = static_cast<Inner *>(node);
+            for (size_t i = 0; i <= inner->count; ++i)
+                destroy(inner->children[i], level - 1);
+            inner->~Inner();
+        }
+    }
+
+    ObjectPool<Leaf> _leaves;
+    ObjectPool<Inner> _inners;
+    Node *_root = nullptr;
+    Leaf *_first = nullptr;
+    size_t _depth = 0;
+    size_t _size = 0;
+    [[no_unique_address]] Compare _less;
+};
+
+#endif
@@ -0,0 +1,257 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+#include "bplus_tree.hpp"
+
+TEST(BPlusTree, NodeSizes)
+{
+    // Four cache lines of ints.
+    EXPECT_EQ((BPlusTree<int, int>::leaf_keys), 30u);
+    EXPECT_EQ((BPlusTree<int, int>::inner_keys), 20u);
+    // Never less than 4, however big the entries are.
+    EXPECT_EQ((BPlusTree<int, int, std::less<int>, 64>::leaf_keys), 6u);
+    EXPECT_EQ((BPlusTree<std::string, std::string>::leaf_keys), 4u);
+}
+
+TEST(BPlusTree, AgainstStdMap)
+{
+    // Small nodes, so there are plenty of splits and levels.
+    BPlusTree<int, int, std::less<int>, 64> tree;
+    std::map<int, int> reference;
+    std::mt19937 random(1);
+    EXPECT_EQ(tree.begin(), tree.end());
+    EXPECT_FALSE(tree.contains(3));
+    EXPECT_EQ(tree.lower_bound(3), tree.end());
+    for (auto i = 0; i < 20000; ++i)
+    {
+        auto key = (int)(random() % 5000);
+        EXPECT_EQ(tree.insert(key, i), reference.insert({key, i}).second);
+    }
+    EXPECT_GT(tree.depth(), 3u);
+    ASSERT_EQ(tree.size(), reference.size());
+    auto expected = reference.begin();
+    for (auto [key, value] : tree)
+    {
+        EXPECT_EQ(key, expected->first);
+        EXPECT_EQ(value, expected->second);
+        ++expected;
+    }
+    EXPECT_EQ(expected, reference.end());
+    for (auto key = -1; key < 5001; ++key)
+    {
+        EXPECT_EQ(tree.contains(key), reference.contains(key));
+        auto lower = tree.lower_bound(key);
+        auto expected_lower = reference.lower_bound(key);
+        if (expected_lower == reference.end())
+        {
+            EXPECT_EQ(lower, tree.end());
+        }
+        else
+        {
+            EXPECT_EQ(lower.key(), expected_lower->first);
+        }
+        auto upper = tree.upper_bound(key);
+        auto expected_upper = reference.upper_bound(key);
+        if (expected_upper == reference.end())
+        {
+            EXPECT_EQ(upper, tree.end());
+        }
+        else
+        {
+            EXPECT_EQ(upper.key(), expected_upper->first);
+        }
+    }
+
+    // Erase half of them, which leaves some leaves empty.
+    for (auto key = 0; key < 5000; ++key)
+    {
+        if (key % 4 < 2)
+        {
+            EXPECT_EQ(tree.erase(key), reference.erase(key));
+        }
+    }
+    for (auto key = 1000; key < 2000; ++key)
+        EXPECT_EQ(tree.erase(key), reference.erase(key));
+    ASSERT_EQ(tree.size(), reference.size());
+    expected = reference.begin();
+    for (auto [key, value] : tree)
+    {
+        EXPECT_EQ(key, expected->first);
+        ++expected;
+    }
+    EXPECT_EQ(tree.lower_bound(1000).key(), reference.lower_bound(1000)->first);
+
+    // And the space they left can be filled again.
+    for (auto key = 1000; key < 2000; ++key)
+    {
+        tree[key] = key;
+        reference[key] = key;
+    }
+    EXPECT_TRUE(std::ranges::equal(tree, reference, [](auto a, auto b)
+                                   { return a.first == b.first && a.second == b.second; }));
+}
+
+TEST(BPlusTree, VectorSearch)
+{
+    // ints and doubles are searched with SSE2 or NEON compares where
+    // we have them, and nodes that aren't a whole number of vectors
+    // full leave a few keys over for the scalar loop.
+#if defined(__SSE2__) || (defined(__ARM_NEON) && defined(__aarch64__))
+    EXPECT_TRUE((BPlusTree<int, int>::simd_search));
+    EXPECT_TRUE((BPlusTree<double, int>::simd_search));
+#endif
+    EXPECT_FALSE((BPlusTree<int64_t, int>::simd_search));
+    EXPECT_FALSE((BPlusTree<int, int, std::greater<int>>::simd_search));
+    EXPECT_EQ((BPlusTree<double, double>::leaf_keys), 15u);
+
+    BPlusTree<double, double> tree;
+    std::map<double, double> reference;
+    std::mt19937 random(2);
+    for (auto i = 0; i < 20000; ++i)
+    {
+        // Halves, so we can look up between keys as well as at them.
+        auto key = (double)((int)(random() % 8000) - 4000) / 2;
+        EXPECT_EQ(tree.insert(key, i), reference.insert({key, i}).second);
+    }
+    ASSERT_EQ(tree.size(), reference.size());
+    for (auto i = -8002; i <= 8002; ++i)
+    {
+        auto key = (double)i / 4;
+        EXPECT_EQ(tree.contains(key), reference.contains(key));
+        auto lower = tree.lower_bound(key);
+        auto expected_lower = reference.lower_bound(key);
+        if (expected_lower == reference.end())
+        {
+            EXPECT_EQ(lower, tree.end());
+        }
+        else
+        {
+            EXPECT_EQ(lower.key(), expected_lower->first);
+        }
+        auto upper = tree.upper_bound(key);
+        auto expected_upper = reference.upper_bound(key);
+        if (expected_upper == reference.end())
+        {
+            EXPECT_EQ(upper, tree.end());
+        }
+        else
+        {
+            EXPECT_EQ(upper.key(), expected_upper->first);
+        }
+    }
+
+    // Negative ints, so a compare that ignored the sign would show.
+    BPlusTree<int, int> ints;
+    std::map<int, int> int_reference;
+    for (auto i = 0; i < 20000; ++i)
+    {
+        auto key = (int)(random() % 10000) - 5000;
+        ints[key] = i;
+        int_reference[key] = i;
+    }
+    for (auto key = -5001; key <= 5001; ++key)
+    {
+        auto found = ints.find(key);
+        auto expected = int_reference.find(key);
+        if (expected == int_reference.end())
+        {
+            EXPECT_EQ(found, ints.end());
+        }
+        else
+        {
+            ASSERT_NE(found, ints.end());
+            EXPECT_EQ(found.value(), expected->second);
+        }
+        auto upper = ints.upper_bound(key);
+        auto expected_upper = int_reference.upper_bound(key);
+        if (expected_upper == int_reference.end())
+        {
+            EXPECT_EQ(upper, ints.end());
+        }
+        else
+        {
+            EXPECT_EQ(upper.key(), expected_upper->first);
+        }
+    }
+}
+
+TEST(BPlusTree, Strings)
+{
+    // Not arithmetic, so this is the std::lower_bound path, and the
+    // destructors have to be run.
+    BPlusTree<std::string, std::string> tree;
+    for (auto i = 0; i < 1000; ++i)
+        tree[std::to_string(i)] = "value " + std::to_string(i);
+    EXPECT_EQ(tree.at("123"), "value 123");
+    EXPECT_THROW(tree.at("1000"), std::out_of_range);
+    EXPECT_FALSE(tree.insert("123", "other"));
+    EXPECT_EQ(tree.at("123"), "value 123");
+
+    // A range scan: everything starting with 99.
+    std::vector<std::string> found;
+    for (auto it = tree.lower_bound("99"); it != tree.lower_bound("9:"); ++it)
+        found.push_back(it.key());
+    EXPECT_EQ(found, (std::vector<std::string>{"99", "990", "991", "992", "993", "994",
+                                               "995", "996", "997", "998", "999"}));
+
+    for (auto [key, value] : tree)
+        value = key;
+    EXPECT_EQ(tree.at("5"), "5");
+
+    auto copy = tree;
+    copy["5"] = "five";
+    EXPECT_EQ(tree.at("5"), "5");
+    EXPECT_EQ(copy.size(), 1000u);
+    auto moved = std::move(copy);
+    EXPECT_EQ(moved.at("5"), "five");
+    EXPECT_TRUE(copy.empty());
+    EXPECT_EQ(copy.begin(), copy.end());
+    moved.clear();
+    EXPECT_TRUE(moved.empty());
+    moved["again"] = "yes";
+    EXPECT_EQ(moved.at("again"), "yes");
+}
+
+// Not really a test: point inserts, lookups and a full scan of random
+// keys, against std::map.
+TEST(BPlusTree, DISABLED_Benchmark)
+{
+    const int n = 500000;
+    std::vector<int> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(3));
+    auto time = [](auto f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    BPlusTree<int, int> tree;
+    std::map<int, int> map;
+    auto tree_insert = time([&]
+                            { for (auto k : keys) tree.insert(k, k); });
+    auto map_insert = time([&]
+                           { for (auto k : keys) map.insert({k, k}); });
+    size_t tree_found = 0, map_found = 0;
+    auto tree_lookup = time([&]
+                            { for (auto k : keys) tree_found += tree.contains(k); });
+    auto map_lookup = time([&]
+                           { for (auto k : keys) map_found += map.contains(k); });
+    long tree_sum = 0, map_sum = 0;
+    auto tree_scan = time([&]
+                          { for (auto [k, v] : tree) tree_sum += v; });
+    auto map_scan = time([&]
+                         { for (auto &[k, v] : map) map_sum += v; });
+    EXPECT_EQ(tree_found, (size_t)n);
+    EXPECT_EQ(map_found, (size_t)n);
+    EXPECT_EQ(tree_sum, map_sum);
+    std::cout << n << " inserts: BPlusTree " << tree_insert << "s, std::map " << map_insert << "s\n"
+              << n << " lookups: BPlusTree " << tree_lookup << "s, std::map " << map_lookup << "s\n"
+              << "full scan: BPlusTree " << tree_scan << "s, std::map " << map_scan << "s\n";
+}
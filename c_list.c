@@ -3,19 +3,33 @@
 
 #include "c_list.h"
 
+// Slabs start small (so short lists stay small) and double up to this.
+#define FIRST_SLAB 16
+#define MAX_SLAB 65536
+
+typedef struct linked_list_slab
+{
+    struct linked_list_slab *next;
+    size_t used;
+    size_t capacity;
+    linked_list_cell cells[];
+} linked_list_slab;
+
 linked_list *new_linked_list()
 {
     linked_list *ret = (linked_list *)malloc(
         sizeof(linked_list));
     ret->length = 0;
     ret->head = NULL;
+    ret->tail = NULL;
+    ret->slabs = NULL;
     return ret;
 };
 
 void free_linked_list(linked_list *l)
 {
-    linked_list_cell *at = l->head;
-    linked_list_cell *tmp = at;
+    linked_list_slab *at = l->slabs;
+    linked_list_slab *tmp = at;
     while (at)
     {
         tmp = at->next;
@@ -25,34 +39,123 @@ void free_linked_list(linked_list *l)
     free(l);
 }
 
+static void add_slab(linked_list *l, size_t capacity)
+{
+    linked_list_slab *slab = malloc(sizeof(linked_list_slab) +
+                                    capacity * sizeof(linked_list_cell));
+    slab->next = l->slabs;
+    slab->used = 0;
+    slab->capacity = capacity;
+    l->slabs = slab;
+}
+
+static linked_list_cell *new_cell(linked_list *l)
+{
+    linked_list_slab *slab = l->slabs;
+    if (slab == NULL || slab->used == slab->capacity)
+    {
+        size_t capacity = FIRST_SLAB;
+        if (slab != NULL)
+        {
+            capacity = slab->capacity * 2;
+        }
+        if (capacity > MAX_SLAB)
+        {
+            capacity = MAX_SLAB;
+        }
+        add_slab(l, capacity);
+        slab = l->slabs;
+    }
+    return &slab->cells[slab->used++];
+}
+
+void linked_list_reserve(linked_list *l, size_t n)
+{
+    linked_list_slab *slab = l->slabs;
+    size_t room = slab ? slab->capacity - slab->used : 0;
+    if (room < n)
+    {
+        // Whatever was left in the old slab is wasted, but that's
+        // less than one slab's worth.
+        add_slab(l, n);
+    }
+}
+
 void prepend(linked_list *l, void *data)
 {
-    linked_list_cell *node = malloc(sizeof(linked_list_cell));
+    linked_list_cell *node = new_cell(l);
     node->next = l->head;
     l->head = node;
     node->data = data;
+    if (l->tail == NULL)
+    {
+        l->tail = node;
+    }
     l->length += 1;
 }
 
 void append(linked_list *l, void *data)
 {
-    linked_list_cell *tmp = l->head;
-    l->length += 1;
+    linked_list_cell *node = new_cell(l);
+    node->data = data;
+    node->next = NULL;
     if (l->head == NULL)
     {
-        l->head = malloc(sizeof(linked_list_cell));
-        l->head->next = NULL;
-        l->head->data = data;
-        return;
+        l->head = node;
     }
-    while (tmp->next != NULL)
+    else
     {
-        tmp = tmp->next;
+        l->tail->next = node;
     }
-    tmp->next = malloc(sizeof(linked_list_cell));
-    tmp->next->data = data;
-    tmp->next->next = NULL;
-    return;
+    l->tail = node;
+    l->length += 1;
+}
+
+void linked_list_append_array(linked_list *l, void **items, size_t n)
+{
+    size_t i;
+    linked_list_reserve(l, n);
+    for (i = 0; i < n; ++i)
+    {
+        append(l, items[i]);
+    }
+}
+
+linked_list *linked_list_from_array(void **items, size_t n)
+{
+    linked_list *ret = new_linked_list();
+    linked_list_append_array(ret, items, n);
+    return ret;
+}
+
+size_t linked_list_to_array(linked_list *l, void **out, size_t max)
+{
+    linked_list_cell *at = l->head;
+    size_t i = 0;
+    while (at != NULL && i < max)
+    {
+        out[i++] = at->data;
+        at = at->next;
+    }
+    return i;
+}
+
+linked_list_iterator linked_list_iter(linked_list *l)
+{
+    linked_list_iterator ret;
+    ret.at = l->head;
+    return ret;
+}
+
+bool linked_list_iter_next(linked_list_iterator *it, void **data)
+{
+    if (it->at == NULL)
+    {
+        return false;
+    }
+    *data = it->at->data;
+    it->at = it->at->next;
+    return true;
 }
 
 // Returns NULL if out of range
@@ -74,7 +177,7 @@ void *get_at(linked_list *l, size_t index)
 void set_at(linked_list *l, size_t index, void *data)
 {
     linked_list_cell *at = l->head;
-    size_t i;
+    size_t i = 0;
     while (at != NULL)
     {
         if (index == i)
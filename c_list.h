@@ -2,6 +2,7 @@
 #define _C_LIST_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef struct linked_list_cell
 {
@@ -9,10 +10,21 @@ typedef struct linked_list_cell
     struct linked_list_cell *next;
 } linked_list_cell;
 
+// Cells aren't malloced one at a time, but carved out of slabs, which
+// are only freed (all together) by free_linked_list.  That's one
+// malloc per slab rather than per cell, and cells added one after
+// another sit next to each other in memory.  (What a slab looks like
+// is c_list.c's business.)
+struct linked_list_slab;
+
 typedef struct linked_list
 {
     struct linked_list_cell *head;
     size_t length;
+    // The last cell, so append doesn't have to walk to it.
+    struct linked_list_cell *tail;
+    // The slab we are filling, which points to the ones before it.
+    struct linked_list_slab *slabs;
 } linked_list;
 
 linked_list *new_linked_list();
@@ -30,4 +42,36 @@ int find_at(linked_list *l, bool (*matcher)(void *));
 
 void free_linked_list(linked_list *l);
 
-#endif
\ No newline at end of file
+// Makes room for n more cells in one allocation, so that the next n
+// prepends or appends don't need any.
+void linked_list_reserve(linked_list *l, size_t n);
+
+// Appends all n items, in order.
+void linked_list_append_array(linked_list *l, void **items, size_t n);
+
+// A new list of the n items, in order.
+linked_list *linked_list_from_array(void **items, size_t n);
+
+// Copies (up to max of) the list's items into out, in order, and
+// returns how many it copied.
+size_t linked_list_to_array(linked_list *l, void **out, size_t max);
+
+// For walking a list without get_at (which starts from the head every
+// time):
+//
+//    linked_list_iterator it = linked_list_iter(l);
+//    void *data;
+//    while (linked_list_iter_next(&it, &data))
+//        ...
+typedef struct linked_list_iterator
+{
+    linked_list_cell *at;
+} linked_list_iterator;
+
+linked_list_iterator linked_list_iter(linked_list *l);
+
+// Puts the next item in *data and returns true, or returns false at
+// the end.
+bool linked_list_iter_next(linked_list_iterator *it, void **data);
+
+#endif
@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include <vector>
+#include <chrono>
+#include <iostream>
 
 extern "C"
 {
@@ -100,4 +102,78 @@ TEST(C_LIST, qsort_test)
     for (i = 0; i < 4; ++i){
         EXPECT_STREQ(test[i], sorted[i]);
     }
-}
\ No newline at end of file
+}
+
+TEST(C_LIST, PrependThenAppend)
+{
+    // append has to know the tail even when only prepend set it.
+    linked_list *l = new_linked_list();
+    int items[3];
+    prepend(l, &items[1]);
+    append(l, &items[2]);
+    prepend(l, &items[0]);
+    for (size_t i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ(get_at(l, i), &items[i]);
+    }
+    set_at(l, 2, &items[0]);
+    EXPECT_EQ(get_at(l, 2), &items[0]);
+    set_at(l, 3, &items[0]);
+    EXPECT_EQ(l->length, 3u);
+    free_linked_list(l);
+}
+
+TEST(C_LIST, BulkAndIterator)
+{
+    std::vector<int> values(1000);
+    std::vector<void *> pointers;
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        values[i] = (int)i;
+        pointers.push_back(&values[i]);
+    }
+    linked_list *l = linked_list_from_array(pointers.data(), pointers.size());
+    EXPECT_EQ(l->length, 1000u);
+    linked_list_append_array(l, pointers.data(), 10);
+    EXPECT_EQ(l->length, 1010u);
+
+    linked_list_iterator it = linked_list_iter(l);
+    void *data;
+    size_t i = 0;
+    while (linked_list_iter_next(&it, &data))
+    {
+        EXPECT_EQ(*(int *)data, (int)(i % 1000));
+        i++;
+    }
+    EXPECT_EQ(i, 1010u);
+    EXPECT_FALSE(linked_list_iter_next(&it, &data));
+
+    std::vector<void *> out(2000);
+    EXPECT_EQ(linked_list_to_array(l, out.data(), out.size()), 1010u);
+    EXPECT_EQ(out[1009], pointers[9]);
+    EXPECT_EQ(linked_list_to_array(l, out.data(), 5), 5u);
+    free_linked_list(l);
+
+    linked_list *empty = linked_list_from_array(NULL, 0);
+    it = linked_list_iter(empty);
+    EXPECT_FALSE(linked_list_iter_next(&it, &data));
+    EXPECT_EQ(linked_list_to_array(empty, out.data(), out.size()), 0u);
+    free_linked_list(empty);
+}
+
+// Not really a test: building (and freeing) a 10M entry list, which
+// used to be quadratic.
+TEST(C_LIST, DISABLED_BuildBenchmark)
+{
+    const size_t n = 10000000;
+    auto start = std::chrono::steady_clock::now();
+    linked_list *l = new_linked_list();
+    for (size_t i = 0; i < n; ++i)
+    {
+        append(l, (void *)i);
+    }
+    free_linked_list(l);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_LT(elapsed.count(), 30);
+    std::cout << n << " appends and a free: " << elapsed.count() << "s\n";
+}
@@ -0,0 +1,204 @@
+#ifndef CONCURRENT_LLIST_HPP
+#define CONCURRENT_LLIST_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include "llist.hpp"
+
+// A LinkedList that any number of threads can prepend to, append to
+// and iterate over at the same time, without a lock.
+//
+// The cells are linked with atomic pointers, and every change is a
+// single compare-and-swap (CAS) that either links a new cell in or
+// fails because some other thread got there first, in which case we
+// look again and retry.  So a thread never waits for another one to
+// finish anything: somebody's CAS always succeeds.
+//
+//  - prepend swings the head sentinel's next pointer to the new cell.
+//  - append is the Michael and Scott (1996) queue's enqueue: link the
+//    new cell after the last one with a CAS on its next pointer, then
+//    move _tail up to it.  _tail may lag behind the real end (the
+//    thread that linked a cell might not have moved it yet), so any
+//    thread that finds _tail pointing at a cell with a successor
+//    helps move it along first.
+//
+// Nothing is ever removed, so there is no memory to reclaim while the
+// list is in use: a cell that a reader might be looking at is never
+// freed under it, which is what hazard pointers or epochs would
+// otherwise be needed for.  Everything is freed in the destructor,
+// when nobody can be using the list any more.
+//
+// Iteration is wait-free: begin() notes how many appends are done
+// and where the list starts, and then walks just the cells that
+// accounts for, never retrying.  Every element you see is fully
+// constructed.  You see every prepend and append that finished before
+// begin() was called, in order, and nothing after the appends it
+// counted, however many more land while you walk.  An addition that
+// happens during the begin() call itself may or may not be included.
+//
+// To know how many cells that is, each prepended cell records how
+// many prepended cells it and the ones after it make, and each
+// appended cell its position among the appended ones.  _appended is
+// the furthest position any finished append has got to: every cell
+// up to there is linked in, even if its own append hasn't returned
+// yet.  So the count is the first cell's, plus _appended.
+template <class T>
+class ConcurrentLinkedList
+{
+    struct Cell;
+
+    // Just the link, so that the sentinel doesn't need a T.
+    struct Link
+    {
+        std::atomic<Cell *> _next = nullptr;
+    };
+
+    struct Cell : Link
+    {
+        T _data;
+        // How many prepended cells there are from here on (0 for an
+        // appended one).
+        size_t _prepended = 0;
+        // Counting from 1 among the appended cells (0 for a prepended
+        // one).
+        size_t _position = 0;
+
+        Cell(const T &data) : _data(data) {}
+    };
+
+public:
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using reference = const T &;
+        using pointer = const T *;
+
+        Iterator() {}
+        Iterator(Cell *at, size_t left) : _at(left ? at : nullptr), _left(left) {}
+
+        const T &operator*() const { return _at->_data; }
+        const T *operator->() const { return &_at->_data; }
+        Iterator &operator++()
+        {
+            if (--_left == 0)
+                _at = nullptr;
+            else
+                _at = _at->_next.load(std::memory_order_acquire);
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            auto ret = *this;
+            ++*this;
+            return ret;
+        }
+        bool operator==(const Iterator &other) const { return _at == other._at; }
+
+    private:
+        Cell *_at = nullptr;
+        size_t _left = 0;
+    };
+
+    ConcurrentLinkedList() : _tail(&_sentinel) {}
+
+    ConcurrentLinkedList(const ConcurrentLinkedList &) = delete;
+    void operator=(const ConcurrentLinkedList &) = delete;
+
+    // Must not race with anything else, of course.  A loop, for the
+    // same reason as LinkedList::clear().
+    ~ConcurrentLinkedList()
+    {
+        auto at = _sentinel._next.load(std::memory_order_relaxed);
+        while (at)
+        {
+            auto next = at->_next.load(std::memory_order_relaxed);
+            delete at;
+            at = next;
+        }
+    }
+
+    // Everything added so far (by the time this looks).  Concurrent
+    // additions may or may not be counted yet.
+    size_t len() const { return _len.load(std::memory_order_acquire); }
+
+    void prepend(const T &data)
+    {
+        auto cell = new Cell(data);
+        // Acquire, since we read first's count.
+        auto first = _sentinel._next.load(std::memory_order_acquire);
+        do
+        {
+            cell->_next.store(first, std::memory_order_relaxed);
+            cell->_prepended = (first ? first->_prepended : 0) + 1;
+        } while (!_sentinel._next.compare_exchange_weak(first, cell, std::memory_order_release,
+                                                        std::memory_order_acquire));
+        _len.fetch_add(1, std::memory_order_release);
+    }
+
+    void append(const T &data)
+    {
+        auto cell = new Cell(data);
+        while (true)
+        {
+            auto last = _tail.load(std::memory_order_acquire);
+            auto next = last->_next.load(std::memory_order_acquire);
+            if (next)
+            {
+                // _tail is behind: help it along, then try again.
+                _tail.compare_exchange_weak(last, next, std::memory_order_release,
+                                            std::memory_order_relaxed);
+                continue;
+            }
+            auto before = last == &_sentinel ? nullptr : static_cast<Cell *>(last);
+            cell->_position = (before ? before->_position : 0) + 1;
+            Cell *expected = nullptr;
+            if (last->_next.compare_exchange_weak(expected, cell, std::memory_order_release,
+                                                  std::memory_order_relaxed))
+            {
+                // Linked in.  If this fails, somebody already helped.
+                _tail.compare_exchange_strong(last, cell, std::memory_order_release,
+                                              std::memory_order_relaxed);
+                break;
+            }
+        }
+        auto furthest = _appended.load(std::memory_order_relaxed);
+        while (furthest < cell->_position &&
+               !_appended.compare_exchange_weak(furthest, cell->_position, std::memory_order_release,
+                                                std::memory_order_relaxed))
+        {
+        }
+        _len.fetch_add(1, std::memory_order_release);
+    }
+
+    // Only const access: two threads writing the same element would
+    // race however the list is built.
+    Iterator begin() const
+    {
+        // The appends first: every cell they count is linked already,
+        // and comes after every prepended cell, wherever the head is
+        // by the time we look.
+        auto appended = _appended.load(std::memory_order_acquire);
+        auto first = _sentinel._next.load(std::memory_order_acquire);
+        auto prepended = first ? first->_prepended : 0;
+        return Iterator(first, prepended + appended);
+    }
+    Iterator end() const { return Iterator(); }
+    Iterator cbegin() const { return begin(); }
+    Iterator cend() const { return end(); }
+
+private:
+    // _sentinel._next is the first real cell.  Having a link there
+    // (rather than a plain head pointer) means appending to an empty
+    // list is no different from appending to any other.
+    Link _sentinel;
+    std::atomic<Link *> _tail;
+    std::atomic<size_t> _len = 0;
+    std::atomic<size_t> _appended = 0;
+};
+
+#endif
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <ranges>
+#include <thread>
+#include <vector>
+#include "concurrent_llist.hpp"
+
+TEST(ConcurrentLinkedList, SingleThreaded)
+{
+    ConcurrentLinkedList<std::string> foo;
+    EXPECT_EQ(foo.begin(), foo.end());
+    foo.append("b");
+    foo.prepend("a");
+    foo.append("c");
+    EXPECT_EQ(foo.len(), 3u);
+    std::vector<std::string> seen(foo.begin(), foo.end());
+    EXPECT_EQ(seen, (std::vector<std::string>{"a", "b", "c"}));
+    EXPECT_EQ(to_string(foo), "[a, b, c]");
+}
+
+TEST(ConcurrentLinkedList, ManyThreads)
+{
+    const int threads = 4;
+    const int each = 20000;
+    ConcurrentLinkedList<int> foo;
+    std::atomic<bool> done = false;
+    // How many each writer has finished, of each kind.
+    std::vector<std::atomic<int>> appends(threads), prepends(threads);
+    {
+        // A reader going round and round while the writers work.  It
+        // must see everything finished before it started.
+        std::jthread reader([&]()
+                            {
+                                while (!done)
+                                {
+                                    auto n = foo.len();
+                                    std::vector<int> appended(threads), prepended(threads);
+                                    for (auto t = 0; t < threads; ++t)
+                                    {
+                                        appended[(size_t)t] = appends[(size_t)t];
+                                        prepended[(size_t)t] = prepends[(size_t)t];
+                                    }
+                                    size_t seen = 0;
+                                    for (auto x : foo)
+                                    {
+                                        ASSERT_GE(x, 0);
+                                        auto t = (size_t)(x / each);
+                                        if (x % 2)
+                                            appended[t]--;
+                                        else
+                                            prepended[t]--;
+                                        seen++;
+                                    }
+                                    ASSERT_GE(seen, n);
+                                    // It can also see cells whose appends
+                                    // haven't returned (or counted) yet.
+                                    ASSERT_LE(seen, (size_t)(threads * each));
+                                    for (auto t = 0; t < threads; ++t)
+                                    {
+                                        ASSERT_LE(appended[(size_t)t], 0);
+                                        ASSERT_LE(prepended[(size_t)t], 0);
+                                    }
+                                } });
+        std::vector<std::jthread> writers;
+        for (auto t : std::views::iota(0, threads))
+        {
+            writers.emplace_back([&, t]()
+                                 {
+                                    for (auto i : std::views::iota(0, each))
+                                    {
+                                        auto value = t * each + i;
+                                        if (i % 2)
+                                        {
+                                            foo.append(value);
+                                            appends[(size_t)t]++;
+                                        }
+                                        else
+                                        {
+                                            foo.prepend(value);
+                                            prepends[(size_t)t]++;
+                                        }
+                                    } });
+        }
+        writers.clear();
+        done = true;
+    }
+    ASSERT_EQ(foo.len(), (size_t)(threads * each));
+    std::vector<int> all(foo.begin(), foo.end());
+    ASSERT_EQ(all.size(), (size_t)(threads * each));
+
+    // Everything is there once, and each thread's appends are in the
+    // order it made them (its prepends in reverse).
+    std::vector<int> sorted = all;
+    std::sort(sorted.begin(), sorted.end());
+    for (auto i = 0; i < threads * each; ++i)
+        ASSERT_EQ(sorted[(size_t)i], i);
+    std::vector<int> last_append(threads, -1), last_prepend(threads, each);
+    for (auto x : all)
+    {
+        auto t = x / each;
+        auto i = x % each;
+        if (i % 2)
+        {
+            ASSERT_GT(i, last_append[(size_t)t]);
+            last_append[(size_t)t] = i;
+        }
+        else
+        {
+            ASSERT_LT(i, last_prepend[(size_t)t]);
+            last_prepend[(size_t)t] = i;
+        }
+    }
+}
+
+// Not really a test: appends from several threads, lock free against
+// a LinkedList behind a mutex.  Don't expect much from one core.
+TEST(ConcurrentLinkedList, DISABLED_Benchmark)
+{
+    const int threads = 4;
+    const int each = 100000;
+    auto run = [&](auto append)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::jthread> workers;
+        for (auto t : std::views::iota(0, threads))
+        {
+            workers.emplace_back([&, t]()
+                                 {
+                                    for (auto i : std::views::iota(0, each))
+                                        append(t * each + i); });
+        }
+        workers.clear();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    ConcurrentLinkedList<int> lock_free;
+    LinkedList<int> locked;
+    std::mutex lock;
+    auto free_time = run([&](int x)
+                         { lock_free.append(x); });
+    auto locked_time = run([&](int x)
+                           { std::unique_lock l(lock); locked.append(x); });
+    EXPECT_EQ(lock_free.len(), locked.len());
+    std::cout << threads << " threads appending: lock free " << free_time
+              << "s, LinkedList and a mutex " << locked_time << "s\n";
+}
@@ -6,6 +6,13 @@
 #include <iostream>
 #include <sstream>
 #include <functional>
+#include <concepts>
+#include <deque>
+#include <cstddef>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+#include <utility>
 
 // Yes, C++ standard containers already have a similar (and indeed more advanced)
 // version called std::list, but we are doing this as an example of how
@@ -15,6 +22,8 @@ template <class T>
 class LinkedListCell;
 template <class T>
 class LinkedList;
+template <class T>
+class PersistentList;
 
 class SliceException : public std::exception
 {
@@ -26,56 +35,100 @@ protected:
     std::string _msg;
 };
 
+// These are proper forward iterators (std::forward_iterator), so a
+// LinkedList is a std::ranges::forward_range and works with
+// <algorithm>, std::ranges and std::views.  They are a plain pointer
+// to the current cell: copying or advancing one doesn't touch any
+// reference counts.  That also means, as with the standard containers,
+// an iterator is only good while its list is.
 template <class T>
-class LinkedListIterator : std::input_iterator_tag
+class LinkedListIterator
 {
 public:
-    void operator++()
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using reference = T &;
+    using pointer = T *;
+
+    LinkedListIterator &operator++()
+    {
+        _at = _at->_next.get();
+        return *this;
+    }
+
+    LinkedListIterator operator++(int)
     {
-        _at = _at->_next;
+        auto ret = *this;
+        _at = _at->_next.get();
+        return ret;
     }
 
-    bool operator!=(LinkedListIterator<T> &comp)
+    bool operator==(const LinkedListIterator<T> &comp) const
     {
-        (void)comp; // Suppresses unused variable compiler warning
-        return _at != nullptr;
+        return _at == comp._at;
     }
 
-    T &operator*()
+    T &operator*() const
     {
         return _at->_data;
     }
 
-    LinkedListIterator(std::shared_ptr<LinkedListCell<T>> at) { _at = at; }
+    T *operator->() const
+    {
+        return &_at->_data;
+    }
+
+    LinkedListIterator() {}
+    LinkedListIterator(LinkedListCell<T> *at) { _at = at; }
 
 protected:
-    std::shared_ptr<LinkedListCell<T>> _at;
+    LinkedListCell<T> *_at = nullptr;
 };
 
 template <class T>
-class ConstLinkedListIterator : std::input_iterator_tag
+class ConstLinkedListIterator
 {
 public:
-    void operator++()
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using reference = const T &;
+    using pointer = const T *;
+
+    ConstLinkedListIterator &operator++()
+    {
+        _at = _at->_next.get();
+        return *this;
+    }
+
+    ConstLinkedListIterator operator++(int)
     {
-        _at = _at->_next;
+        auto ret = *this;
+        _at = _at->_next.get();
+        return ret;
     }
 
-    bool operator!=(const ConstLinkedListIterator<T> &comp)
+    bool operator==(const ConstLinkedListIterator<T> &comp) const
     {
-        (void)comp; // Suppresses unused variable compiler warning
-        return _at != nullptr;
+        return _at == comp._at;
     }
 
-    const T &operator*()
+    const T &operator*() const
     {
         return _at->_data;
     }
 
-    ConstLinkedListIterator(std::shared_ptr<LinkedListCell<T>> at) { _at = at; }
+    const T *operator->() const
+    {
+        return &_at->_data;
+    }
+
+    ConstLinkedListIterator() {}
+    ConstLinkedListIterator(const LinkedListCell<T> *at) { _at = at; }
 
 protected:
-    std::shared_ptr<LinkedListCell<T>> _at;
+    const LinkedListCell<T> *_at = nullptr;
 };
 
 template <class T>
@@ -85,6 +138,7 @@ public:
     friend class LinkedList<T>;
     friend class LinkedListIterator<T>;
     friend class ConstLinkedListIterator<T>;
+    friend class PersistentList<T>;
 
     LinkedListCell(const T &data, std::shared_ptr<LinkedListCell<T>> next)
     {
@@ -97,10 +151,19 @@ protected:
     std::shared_ptr<LinkedListCell<T>> _next;
 };
 
+// A singly linked list of shared cells.
+//
+// Not thread safe, and that includes operator[]: a lookup moves the
+// finger it keeps (and can rebuild a stale index), so even threads
+// that only read elements with it race with each other.  Share a
+// list between threads behind a lock, or have the readers use
+// iterators (which don't touch the list) instead.
 template <class T>
 class LinkedList
 {
 public:
+    friend class PersistentList<T>;
+
     LinkedList()
     {
         _head = nullptr;
@@ -120,9 +183,8 @@ public:
         }
 
         // Otherwise, we erase our old data...
-        _head = nullptr;
-        _tail = nullptr;
-        _len = 0;
+        clear();
+        _stride = other._stride;
         for (const auto &data : other)
         {
             append(data);
@@ -135,18 +197,123 @@ public:
         _head = nullptr;
         _tail = nullptr;
         _len = 0;
+        _stride = other._stride;
         for (const auto &data : other)
         {
             append(data);
         }
     }
 
+    // Moving hands the cells over without copying any of them, so
+    // returning a list from a function (list_map, list_filter...)
+    // costs O(1).  other is left empty.
+    LinkedList(LinkedList &&other) noexcept
+    {
+        _len = 0;
+        take_cells(other);
+    }
+
+    LinkedList &operator=(LinkedList &&other) noexcept
+    {
+        if (&other == this)
+            return *this;
+        clear();
+        take_cells(other);
+        return *this;
+    }
+
+    virtual ~LinkedList() { clear(); }
+
+    // Lets go of the cells one at a time, in a loop.  Just dropping
+    // _head would destroy the first cell, whose destructor drops its
+    // _next and so destroys the second, and so on: a stack frame per
+    // element, which overflows the stack somewhere around a million
+    // elements.  (Nothing else holds on to our cells, but if something
+    // did, we would stop at it: it keeps the rest alive anyway.)
+    virtual void clear()
+    {
+        _tail = nullptr;
+        auto at = std::move(_head);
+        while (at && at.use_count() == 1)
+            at = std::move(at->_next);
+        _len = 0;
+        forget_positions();
+    }
+
     virtual size_t len() { return _len; }
 
+    // Moves all of other's cells onto our end, in O(1): it is just
+    // relinking our last cell to other's first.  other is left empty.
+    // (If we have an index, it is rebuilt on the next operator[].)
+    virtual void splice(LinkedList &other)
+    {
+        if (&other == this || !other._head)
+            return;
+        if (_head)
+            _tail->_next = std::move(other._head);
+        else
+            _head = std::move(other._head);
+        _tail = std::move(other._tail);
+        _len += other._len;
+        _index_stale = _stride != 0;
+        other._len = 0;
+        other.forget_positions();
+    }
+
+    void splice(LinkedList &&other) { splice(other); }
+
+    // Cuts the list in two: we keep [0, pos), and the rest, [pos,
+    // len()), is handed back as a new list.  No elements are copied.
+    // Finding the cut is a walk, which the finger and the index speed
+    // up just as they do for operator[].
+    virtual LinkedList split_at(size_t pos)
+    {
+        if (pos > _len)
+            throw SliceException("Index out of range");
+        LinkedList ret;
+        if (pos == _len)
+            return ret;
+        if (pos == 0)
+        {
+            ret.take_cells(*this);
+            return ret;
+        }
+        // We need the shared_ptr to our new last cell, which is
+        // whatever points to it.
+        auto last = pos == 1 ? _head : locate(pos - 2)->_next;
+        ret._head = std::move(last->_next);
+        ret._tail = std::move(_tail);
+        ret._len = _len - pos;
+        // It gets an index like ours, built when it's first needed.
+        ret._stride = _stride;
+        ret._index_stale = _stride != 0;
+        _tail = std::move(last);
+        _len = pos;
+        if (_finger_pos >= pos)
+            _finger = nullptr;
+        // The checkpoints past the cut went with the other half.
+        while (!_checkpoints.empty() && _base + (_checkpoints.size() - 1) * _stride >= pos)
+            _checkpoints.pop_back();
+        return ret;
+    }
+
     virtual void prepend(const T &data)
     {
         _head = std::make_shared<LinkedListCell<T>>(data, _head);
+        if (!_tail)
+            _tail = _head;
         _len++;
+        // Everything moved along one.
+        if (_finger)
+            _finger_pos++;
+        if (_stride && !_index_stale)
+        {
+            if (++_base == _stride)
+            {
+                _checkpoints.push_front(_head.get());
+                _base = 0;
+            }
+        }
     }
 
     virtual void append(const T &data)
@@ -156,31 +323,55 @@ public:
             _head = std::make_shared<LinkedListCell<T>>(data, nullptr);
             _tail = _head;
             _len++;
+            added_at_end();
             return;
         }
 
         _tail->_next = std::make_shared<LinkedListCell<T>>(data, nullptr);
         _tail = _tail->_next;
         _len++;
+        added_at_end();
     }
 
+    // A list has no random access, so this has to walk there.  But it
+    // doesn't always start from the head: it remembers where the last
+    // lookup ended up (the "finger"), so a loop over list[0],
+    // list[1], ... only ever takes one step each time, rather than
+    // starting over and taking i steps for list[i].  And with
+    // enable_index() it can also start from the nearest checkpoint,
+    // so any lookup is at most stride steps.
     virtual T &operator[](size_t location)
     {
-        auto at = _head;
-        while (true)
+        if (location >= _len)
+            throw SliceException("Index out of range");
+        return locate(location)->_data;
+    }
+
+    // Keeps a checkpoint every stride cells, which makes operator[]
+    // O(stride) rather than O(n), for an extra pointer per stride
+    // elements.  append and prepend keep it up to date in O(1).  A
+    // stride of 0 turns it off again.
+    void enable_index(size_t stride = 64)
+    {
+        _stride = stride;
+        _index_stale = false;
+        _checkpoints.clear();
+        _base = 0;
+        if (!_stride)
+            return;
+        size_t pos = 0;
+        for (auto at = _head.get(); at; at = at->_next.get(), ++pos)
         {
-            if (at == nullptr)
-                throw SliceException("Index out of range");
-            if (location == 0)
-                return at->_data;
-            location--;
-            at = at->_next;
+            if (pos % _stride == 0)
+                _checkpoints.push_back(at);
         }
     }
 
+    void disable_index() { enable_index(0); }
+
     LinkedListIterator<T> begin() const
     {
-        return LinkedListIterator<T>(_head);
+        return LinkedListIterator<T>(_head.get());
     };
     LinkedListIterator<T> end() const
     {
@@ -189,7 +380,7 @@ public:
 
     ConstLinkedListIterator<T> cbegin() const
     {
-        return ConstLinkedListIterator<T>(_head);
+        return ConstLinkedListIterator<T>(_head.get());
     };
     ConstLinkedListIterator<T> cend() const
     {
@@ -197,13 +388,125 @@ public:
     }
 
 protected:
+    // The cell at location, which must be in range.
+    LinkedListCell<T> *locate(size_t location)
+    {
+        if (_index_stale)
+            enable_index(_stride);
+        LinkedListCell<T> *at = _head.get();
+        size_t pos = 0;
+        if (_stride && location >= _base)
+        {
+            auto k = (location - _base) / _stride;
+            at = _checkpoints[k];
+            pos = _base + k * _stride;
+        }
+        if (_finger && _finger_pos <= location && _finger_pos > pos)
+        {
+            at = _finger;
+            pos = _finger_pos;
+        }
+        if (location == _len - 1)
+        {
+            at = _tail.get();
+            pos = location;
+        }
+        for (; pos < location; ++pos)
+            at = at->_next.get();
+        _finger = at;
+        _finger_pos = pos;
+        return at;
+    }
+
+    // Takes over all of other's cells (and its index), leaving it
+    // empty.  Whatever we had must already be cleared.
+    void take_cells(LinkedList &other)
+    {
+        _head = std::move(other._head);
+        _tail = std::move(other._tail);
+        _len = std::exchange(other._len, 0);
+        _finger = std::exchange(other._finger, nullptr);
+        _finger_pos = other._finger_pos;
+        _stride = other._stride;
+        _base = other._base;
+        _index_stale = other._index_stale;
+        _checkpoints = std::move(other._checkpoints);
+        other.forget_positions();
+    }
+
+    // We just added a cell at the end, at position _len - 1.
+    void added_at_end()
+    {
+        auto pos = _len - 1;
+        if (_stride && !_index_stale && pos >= _base && (pos - _base) % _stride == 0)
+            _checkpoints.push_back(_tail.get());
+    }
+
+    // For when the cells change under us wholesale.
+    void forget_positions()
+    {
+        _finger = nullptr;
+        _finger_pos = 0;
+        enable_index(_stride);
+    }
+
     std::shared_ptr<LinkedListCell<T>> _head;
     std::shared_ptr<LinkedListCell<T>> _tail;
     size_t _len;
+
+    // The last cell operator[] found, and its position.
+    LinkedListCell<T> *_finger = nullptr;
+    size_t _finger_pos = 0;
+
+    // The optional index: the cells at positions _base, _base +
+    // _stride, _base + 2 * _stride, ...  A prepend moves them all
+    // along one, which we just note in _base, until there is room
+    // for a new checkpoint at the front.
+    size_t _stride = 0;
+    size_t _base = 0;
+    // After a splice, until the next lookup.
+    bool _index_stale = false;
+    std::deque<LinkedListCell<T> *> _checkpoints;
 };
 
+// a followed by b, without copying either (if you hand them over with
+// std::move, that is): concat(std::move(x), std::move(y)).
 template <class T>
-std::string to_string(LinkedList<T> &in)
+LinkedList<T> concat(LinkedList<T> a, LinkedList<T> b)
+{
+    a.splice(b);
+    return a;
+}
+
+// The helpers below work on any of our list types (LinkedList,
+// PooledLinkedList, UnrolledLinkedList...): anything with len(),
+// append() and iteration.
+template <class L>
+concept ListLike = requires(L &l) {
+    { l.len() } -> std::convertible_to<size_t>;
+    l.begin();
+    l.end();
+};
+
+// The same kind of list as List, but of U.  Works for any list
+// template whose only parameter is the element type; others (like
+// UnrolledLinkedList) say how to rebind themselves with a member
+// template called rebind.
+template <class List, class U>
+struct list_rebind
+{
+    using type = typename List::template rebind<U>;
+};
+
+template <template <class> class L, class T, class U>
+    requires(!requires { typename L<T>::template rebind<U>; })
+struct list_rebind<L<T>, U>
+{
+    using type = L<U>;
+};
+
+template <ListLike List>
+std::string to_string(List &in)
 {
     std::stringstream s;
     s << "[";
@@ -226,35 +529,52 @@ std::string to_string(LinkedList<T> &in)
 // One is probably better served in C++20 to use the
 // std::views | operations and just iterate rather than
 // create a new list, but sometimes you do want a new list
-template <class U, class T>
-LinkedList<U> list_map(LinkedList<T> &in,
-                       std::function<U(T)> f)
+// (see list_map_view and list_filter_view below for the lazy kind).
+//
+// f can be anything callable: a function, a lambda, a functor.  It is
+// a template parameter rather than a std::function, so the call is
+// direct and can be inlined, rather than going through type erasure
+// for every element.  U (the result type) can be left out, and is
+// then whatever f returns; T is only there so that older code
+// spelling out list_map<U, T> still compiles.
+template <class U = void, class T = void, ListLike List, class F>
+auto list_map(List &in, F f)
 {
-    LinkedList<U> ret;
-    for (auto c : in)
+    using Element = std::ranges::range_reference_t<List &>;
+    using Result = std::conditional_t<std::is_void_v<U>,
+                                      std::decay_t<std::invoke_result_t<F &, Element>>, U>;
+    typename list_rebind<List, Result>::type ret;
+    for (auto &&c : in)
     {
         ret.append(f(c));
     }
     return ret;
 }
 
-template <class U, class T>
-U list_reduce(LinkedList<T> &in,
-              std::function<U(U, T)> f, U initval)
+// Works on any range, not just lists, so it can finish off a chain
+// of views: everything then happens in a single pass, one element at
+// a time, with no lists in between:
+//
+//    list_reduce(list_filter_view(foo, is_even)
+//                    | std::views::transform(square),
+//                std::plus<>(), 0);
+template <class U = void, class T = void, std::ranges::input_range R, class F, class I>
+auto list_reduce(R &&in, F f, I initval)
 {
-    for (auto c : in)
+    using Result = std::conditional_t<std::is_void_v<U>, I, U>;
+    Result ret = std::move(initval);
+    for (auto &&c : in)
     {
-        initval = f(initval, c);
+        ret = f(std::move(ret), c);
     }
-    return initval;
+    return ret;
 }
 
-template <class T>
-LinkedList<T> list_filter(LinkedList<T> &in,
-                          std::function<bool(T)> f)
+template <class T = void, ListLike List, class F>
+List list_filter(List &in, F f)
 {
-    LinkedList<T> ret;
-    for (auto c : in)
+    List ret;
+    for (auto &&c : in)
     {
         if (f(c))
             ret.append(c);
@@ -262,4 +582,22 @@ LinkedList<T> list_filter(LinkedList<T> &in,
     return ret;
 }
 
+// The lazy versions.  They don't build anything: they return a view
+// of the list that calls f as you iterate it, and only as far as you
+// go, so taking the first few results of a map over a million
+// elements only calls f a few times.  They are std::views::transform
+// and std::views::filter, so they compose with the rest of std::views
+// (and each other) with |.  The list has to outlive the view.
+template <ListLike List, class F>
+auto list_map_view(List &in, F f)
+{
+    return std::views::transform(in, std::move(f));
+}
+
+template <ListLike List, class F>
+auto list_filter_view(List &in, F f)
+{
+    return std::views::filter(in, std::move(f));
+}
+
 #endif
\ No newline at end of file
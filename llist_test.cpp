@@ -1,5 +1,12 @@
 #include <gtest/gtest.h>
 #include <string>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <ranges>
+#include <vector>
 #include "llist.hpp"
 
 // Demonstrate some basic assertions.
@@ -106,3 +113,204 @@ TEST(LinkedListTest, FunctionalTesting)
                                          { return x + y; }, 0);
     EXPECT_EQ(garplay, 45);
 }
+
+// Destroying this used to recurse once per cell and blow the stack.
+TEST(LinkedListTest, LongListTeardown)
+{
+    auto foo = std::make_unique<LinkedList<int>>();
+    for (auto i = 0; i < 2000000; ++i)
+        foo->prepend(i);
+    EXPECT_EQ(foo->len(), 2000000);
+    foo.reset();
+
+    // Assignment clears the old cells the same way.
+    LinkedList<int> bar;
+    for (auto i = 0; i < 2000000; ++i)
+        bar.append(i);
+    bar = LinkedList<int>();
+    EXPECT_EQ(bar.len(), 0);
+    EXPECT_EQ(bar.begin(), bar.end());
+}
+
+TEST(LinkedListTest, RangesAndViews)
+{
+    static_assert(std::forward_iterator<LinkedListIterator<int>>);
+    static_assert(std::forward_iterator<ConstLinkedListIterator<int>>);
+    static_assert(std::ranges::forward_range<LinkedList<int>>);
+
+    LinkedList<int> foo;
+    for (auto i = 0; i < 10; ++i)
+        foo.append(i);
+    EXPECT_EQ(*std::ranges::find(foo, 4), 4);
+    EXPECT_EQ(std::ranges::distance(foo), 10);
+    EXPECT_EQ(*std::ranges::max_element(foo), 9);
+
+    // Nothing happens until we iterate, and then only as far as we go.
+    int calls = 0;
+    auto squares = list_map_view(foo, [&](int x)
+                                 { calls++; return x * x; });
+    EXPECT_EQ(calls, 0);
+    std::vector<int> first;
+    for (auto x : squares | std::views::take(3))
+        first.push_back(x);
+    EXPECT_EQ(first, (std::vector<int>{0, 1, 4}));
+    EXPECT_EQ(calls, 3);
+
+    // One fused pass: filter, map and sum, with no lists in between.
+    auto sum = list_reduce(list_filter_view(foo, iseven) | std::views::transform([](int x)
+                                                                                { return x * 10; }),
+                           std::plus<>(), 0);
+    EXPECT_EQ(sum, 200);
+
+    // The eager versions take any callable, and work out the type.
+    auto strings = list_map(foo, stringify);
+    EXPECT_EQ(strings[2], "\"2\"");
+    auto odd = list_filter(foo, [](int x)
+                           { return x % 2 == 1; });
+    EXPECT_EQ(to_string(odd), "[1, 3, 5, 7, 9]");
+    std::vector<int> v{1, 2, 3};
+    EXPECT_EQ(list_reduce(v, std::multiplies<>(), 1), 6);
+}
+
+TEST(LinkedListTest, IndexedAccess)
+{
+    // Mix prepends and appends so the checkpoints have to shift.
+    for (size_t stride : {0, 1, 3, 64})
+    {
+        LinkedList<int> foo;
+        std::deque<int> expected;
+        if (stride)
+            foo.enable_index(stride);
+        for (auto i = 0; i < 500; ++i)
+        {
+            if (i % 3 == 0)
+            {
+                foo.prepend(i);
+                expected.push_front(i);
+            }
+            else
+            {
+                foo.append(i);
+                expected.push_back(i);
+            }
+            // Poke around in between, so the finger moves.
+            ASSERT_EQ(foo[(size_t)i / 2], expected[(size_t)i / 2]) << stride;
+        }
+        for (size_t i = 0; i < expected.size(); ++i)
+            ASSERT_EQ(foo[i], expected[i]) << stride;
+        for (size_t i = expected.size(); i-- > 0;)
+            ASSERT_EQ(foo[i], expected[i]) << stride;
+        for (size_t i = 0; i < expected.size(); i += 7)
+            ASSERT_EQ(foo[(i * 31) % expected.size()], expected[(i * 31) % expected.size()]);
+        EXPECT_THROW(foo[expected.size()], SliceException);
+
+        // Copies keep the index, and clearing resets it.
+        auto copy = foo;
+        EXPECT_EQ(copy[250], expected[250]);
+        foo.clear();
+        EXPECT_THROW(foo[0], SliceException);
+        foo.append(5);
+        EXPECT_EQ(foo[0], 5);
+    }
+}
+
+// Not really a test: the legacy "for i in 0..n: list[i]" loop, forward
+// (where the finger is enough) and backward (where it needs the index).
+TEST(LinkedListTest, DISABLED_IndexedBenchmark)
+{
+    const size_t n = 20000;
+    LinkedList<int> foo;
+    for (size_t i = 0; i < n; ++i)
+        foo.append((int)i);
+    auto time = [&]()
+    {
+        auto start = std::chrono::steady_clock::now();
+        long sum = 0;
+        for (size_t i = 0; i < n; ++i)
+            sum += foo[i];
+        for (size_t i = n; i-- > 0;)
+            sum += foo[i];
+        EXPECT_EQ(sum, (long)(n * (n - 1)));
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    auto finger = time();
+    foo.enable_index();
+    auto indexed = time();
+    std::cout << "forward then backward: finger only " << finger << "s, with index " << indexed << "s\n";
+}
+
+TEST(LinkedListTest, MoveSpliceSplit)
+{
+    LinkedList<int> foo;
+    for (auto i = 0; i < 10; ++i)
+        foo.append(i);
+    auto &first = foo[0];
+
+    // Moves hand the cells over: the elements don't move.
+    LinkedList<int> bar(std::move(foo));
+    EXPECT_EQ(foo.len(), 0);
+    EXPECT_EQ(foo.begin(), foo.end());
+    EXPECT_EQ(&bar[0], &first);
+    foo = std::move(bar);
+    EXPECT_EQ(&foo[0], &first);
+    EXPECT_EQ(bar.len(), 0);
+
+    for (size_t stride : {0, 4})
+    {
+        LinkedList<int> a, b;
+        a.enable_index(stride);
+        for (auto i = 0; i < 10; ++i)
+        {
+            a.append(i);
+            b.append(10 + i);
+        }
+        EXPECT_EQ(a[9], 9);
+        auto &eleven = b[1];
+        a.splice(b);
+        EXPECT_EQ(a.len(), 20);
+        EXPECT_EQ(b.len(), 0);
+        EXPECT_EQ(&a[11], &eleven);
+        EXPECT_EQ(a[19], 19);
+        a.append(20);
+        a.prepend(-1);
+        EXPECT_EQ(to_string(a), "[-1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, "
+                                "14, 15, 16, 17, 18, 19, 20]");
+        // b is still usable.
+        b.append(1);
+        EXPECT_EQ(to_string(b), "[1]");
+
+        auto back = a.split_at(12);
+        EXPECT_EQ(a.len(), 12);
+        EXPECT_EQ(back.len(), 10);
+        EXPECT_EQ(&back[0], &eleven);
+        EXPECT_EQ(to_string(a), "[-1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10]");
+        EXPECT_EQ(to_string(back), "[11, 12, 13, 14, 15, 16, 17, 18, 19, 20]");
+        EXPECT_THROW(a[12], SliceException);
+        for (auto i = 0; i < 12; ++i)
+            EXPECT_EQ(a[(size_t)i], i - 1);
+        for (auto i = 0; i < 10; ++i)
+            EXPECT_EQ(back[(size_t)i], 11 + i);
+        a.append(99);
+        EXPECT_EQ(a[12], 99);
+        back.prepend(98);
+        EXPECT_EQ(back[0], 98);
+
+        EXPECT_EQ(a.split_at(a.len()).len(), 0);
+        auto all = a.split_at(0);
+        EXPECT_EQ(a.len(), 0);
+        EXPECT_EQ(all.len(), 13);
+        EXPECT_THROW(all.split_at(14), SliceException);
+        auto one = all.split_at(1);
+        EXPECT_EQ(to_string(all), "[-1]");
+        EXPECT_EQ(one[0], 0);
+    }
+
+    // Merging results is O(1) per list.
+    std::vector<LinkedList<int>> parts(4);
+    for (auto i = 0; i < 4; ++i)
+        parts[(size_t)i].append(i);
+    auto merged = concat(std::move(parts[0]), std::move(parts[1]));
+    merged.splice(parts[2]);
+    merged.splice(std::move(parts[3]));
+    EXPECT_EQ(to_string(merged), "[0, 1, 2, 3]");
+}
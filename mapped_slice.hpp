@@ -0,0 +1,200 @@
+#ifndef MAPPED_SLICE_HPP
+#define MAPPED_SLICE_HPP
+
+#include <string>
+#include <memory>
+#include <span>
+#include <cstring>
+#include <cerrno>
+#include <type_traits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "slice.hpp"
+
+// A file of fixed size records, used directly as an array of T by
+// mapping it into memory (mmap) instead of reading it.  Nothing is
+// read up front: each page is read in by the kernel the first time it
+// is touched, so a multi-gigabyte file costs page faults for the
+// parts you actually look at, not a full read and copy.
+//
+// The records are just the bytes of T, so T needs to be trivially
+// copyable (no pointers, no std::string...) and the file must have
+// been written on a machine with the same layout for T.
+
+// ReadOnly maps the file read only: you can only look.  Private is
+// also copy on write, but at the page level and by the kernel: you
+// can write to the elements, but the writes go to private copies of
+// the pages involved and never reach the file.
+enum class MapMode
+{
+    ReadOnly,
+    Private
+};
+
+// Hints for the kernel about how we will touch the pages (madvise).
+// Sequential makes it read ahead aggressively and drop pages behind
+// us, Random turns read ahead off, and WillNeed starts reading the
+// whole range in now.
+enum class MapAdvice
+{
+    Normal,
+    Sequential,
+    Random,
+    WillNeed
+};
+
+template <class T>
+class MappedSlice
+{
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "A mapped file can only hold trivially copyable records");
+
+public:
+    MappedSlice(const std::string &path, MapMode mode = MapMode::ReadOnly,
+                MapAdvice advice = MapAdvice::Normal)
+    {
+        _mapping = std::make_shared<Mapping>(path, mode);
+        if (_mapping->length % sizeof(T) != 0)
+            throw SliceException("File size is not a multiple of the record size");
+        _base = static_cast<T *>(_mapping->address);
+        _len = _mapping->length / sizeof(T);
+        if (advice != MapAdvice::Normal)
+            advise(advice);
+    }
+
+    // Subrange, sharing the mapping.  The file stays mapped until the
+    // last MappedSlice (or Slice from as_slice) using it is gone.
+    MappedSlice(const MappedSlice &s, int start, int end)
+    {
+        if (start < 0)
+            throw SliceException("Negative Start");
+        if (end < start)
+            throw SliceException("End before start");
+        if ((size_t)end >= s._len)
+            throw SliceException("Can't have slice beyond end");
+        _mapping = s._mapping;
+        _base = s._base + start;
+        _len = (size_t)end - start + 1;
+    }
+
+    const T &operator[](size_t pos) const
+    {
+        if (pos >= _len)
+            throw SliceOutOfBoundsException("Exceeded Bounds");
+        return _base[pos];
+    }
+
+    const T &unchecked(size_t pos) const { return _base[pos]; }
+
+    const T *data() const { return _base; }
+    const T *begin() const { return _base; }
+    const T *end() const { return _base + _len; }
+    size_t size() const { return _len; }
+    bool empty() const { return _len == 0; }
+    std::span<const T> span() const { return std::span<const T>(_base, _len); }
+
+    MapMode mode() const { return _mapping->mode; }
+
+    // Writable access needs a Private mapping.
+    T *mutable_data()
+    {
+        if (_mapping->mode != MapMode::Private)
+            throw SliceException("Can't write to a read only mapping");
+        return _base;
+    }
+
+    // An ordinary Slice over our part of the mapping (borrowed, so
+    // it can't grow), for code that wants a Slice<T>.  Needs a Private
+    // mapping since Slice lets you write.
+    Slice<T> as_slice()
+    {
+        return Slice<T>::borrow(mutable_data(), _len, _mapping);
+    }
+
+    // Can be called again later, say Sequential for a scan and then
+    // Random for lookups.  Only affects our part of the file.
+    void advise(MapAdvice advice)
+    {
+        if (_len == 0)
+            return;
+        int how = MADV_NORMAL;
+        switch (advice)
+        {
+        case MapAdvice::Normal:
+            how = MADV_NORMAL;
+            break;
+        case MapAdvice::Sequential:
+            how = MADV_SEQUENTIAL;
+            break;
+        case MapAdvice::Random:
+            how = MADV_RANDOM;
+            break;
+        case MapAdvice::WillNeed:
+            how = MADV_WILLNEED;
+            break;
+        }
+        // madvise wants a page aligned start.
+        auto page = (uintptr_t)sysconf(_SC_PAGESIZE);
+        auto start = (uintptr_t)_base & ~(page - 1);
+        auto end = (uintptr_t)(_base + _len);
+        if (madvise((void *)start, end - start, how) != 0)
+            throw SliceException(std::string("madvise failed: ") + strerror(errno));
+    }
+
+private:
+    // Owns the actual mapping, and unmaps it when the last slice
+    // using it lets go.
+    struct Mapping
+    {
+        void *address = nullptr;
+        size_t length = 0;
+        MapMode mode;
+
+        Mapping(const std::string &path, MapMode how) : mode(how)
+        {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw SliceException("Can't open " + path + ": " + strerror(errno));
+            struct stat info;
+            if (fstat(fd, &info) != 0)
+            {
+                auto err = errno;
+                close(fd);
+                throw SliceException("Can't stat " + path + ": " + strerror(err));
+            }
+            length = (size_t)info.st_size;
+            // mmap can't map nothing, but an empty file is a fine
+            // empty slice.
+            if (length > 0)
+            {
+                int prot = how == MapMode::Private ? PROT_READ | PROT_WRITE : PROT_READ;
+                address = mmap(nullptr, length, prot, MAP_PRIVATE, fd, 0);
+                if (address == MAP_FAILED)
+                {
+                    auto err = errno;
+                    close(fd);
+                    throw SliceException("Can't map " + path + ": " + strerror(err));
+                }
+            }
+            // The mapping keeps its own reference to the file.
+            close(fd);
+        }
+
+        Mapping(const Mapping &) = delete;
+        void operator=(const Mapping &) = delete;
+
+        ~Mapping()
+        {
+            if (address)
+                munmap(address, length);
+        }
+    };
+
+    std::shared_ptr<Mapping> _mapping;
+    T *_base;
+    size_t _len;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include "mapped_slice.hpp"
+
+struct Record
+{
+    int id;
+    double value;
+};
+
+// A file in the temporary directory, removed again when the test is
+// done with it.
+struct ScratchFile
+{
+    explicit ScratchFile(const std::string &name)
+        : path((std::filesystem::temp_directory_path() / name).string())
+    {
+    }
+    ~ScratchFile() { std::filesystem::remove(path); }
+
+    std::string path;
+};
+
+// Writes count records to file.
+static std::string write_records(const ScratchFile &file, int count)
+{
+    std::ofstream out{file.path, std::ios::binary | std::ios::trunc};
+    for (auto i = 0; i < count; ++i)
+    {
+        Record r{i, i * 0.5};
+        out.write((const char *)&r, sizeof(r));
+    }
+    return file.path;
+}
+
+TEST(MappedSliceTest, ReadOnly)
+{
+    ScratchFile file("mapped_slice_test.bin");
+    auto path = write_records(file, 10000);
+    MappedSlice<Record> m(path, MapMode::ReadOnly, MapAdvice::Sequential);
+    EXPECT_EQ(m.size(), 10000);
+    EXPECT_EQ(m[1234].id, 1234);
+    EXPECT_EQ(m[1234].value, 617);
+    EXPECT_THROW(m[10000], SliceOutOfBoundsException);
+    auto total = std::accumulate(m.begin(), m.end(), 0L, [](long t, const Record &r)
+                                 { return t + r.id; });
+    EXPECT_EQ(total, 9999L * 10000 / 2);
+
+    MappedSlice<Record> sub(m, 100, 199);
+    m.advise(MapAdvice::Random);
+    EXPECT_EQ(sub.size(), 100);
+    EXPECT_EQ(sub[0].id, 100);
+    EXPECT_EQ(sub.span().back().id, 199);
+    EXPECT_THROW(MappedSlice<Record>(m, 9000, 10000), SliceException);
+
+    EXPECT_THROW(m.mutable_data(), SliceException);
+    EXPECT_THROW(m.as_slice(), SliceException);
+}
+
+TEST(MappedSliceTest, PrivateWritesStayPrivate)
+{
+    ScratchFile file("mapped_slice_test_private.bin");
+    auto path = write_records(file, 100);
+    Slice<Record> s;
+    {
+        MappedSlice<Record> m(path, MapMode::Private);
+        MappedSlice<Record> sub(m, 10, 19);
+        sub.mutable_data()[0].id = -1;
+        EXPECT_EQ(m[10].id, -1);
+        // The Slice keeps the mapping alive after the MappedSlices go.
+        s = sub.as_slice();
+    }
+    EXPECT_TRUE(s.is_borrowed());
+    EXPECT_EQ(s.size(), 10);
+    EXPECT_EQ(s[0].id, -1);
+    EXPECT_EQ(s[9].id, 19);
+    Slice<Record> sub(s, 1, 2);
+    EXPECT_EQ(sub[0].id, 11);
+
+    // The file itself never changed.
+    MappedSlice<Record> again(path);
+    EXPECT_EQ(again[10].id, 10);
+}
+
+TEST(MappedSliceTest, BadFiles)
+{
+    ScratchFile missing("mapped_slice_test_missing.bin");
+    EXPECT_THROW(MappedSlice<int>(missing.path), SliceException);
+    ScratchFile odd("mapped_slice_test_odd.bin");
+    {
+        std::ofstream out{odd.path, std::ios::binary | std::ios::trunc};
+        out << "abc";
+    }
+    EXPECT_THROW(MappedSlice<int>(odd.path), SliceException);
+    ScratchFile empty_file("mapped_slice_test_empty.bin");
+    {
+        std::ofstream out{empty_file.path, std::ios::binary | std::ios::trunc};
+    }
+    MappedSlice<int> empty(empty_file.path);
+    EXPECT_TRUE(empty.empty());
+}
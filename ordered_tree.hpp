@@ -0,0 +1,760 @@
+#ifndef ORDERED_TREE_HPP
+#define ORDERED_TREE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <ranges>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "pool.hpp"
+
+// An ordered map (or, with V = void, an ordered set) kept as an AVL
+// tree.  It's the C++ version of Python/orderedtree.py: the insert,
+// the rotations and the rebalancing are the same code, so something
+// prototyped with the Python one should behave the same here, just
+// a lot faster.
+//
+// Unlike the Python one, keys are unique (inserting a key that's
+// already there leaves the old entry alone, as std::map does), and
+// there is an erase.
+//
+// Nodes come from an ObjectPool, so building a tree is a few big
+// allocations rather than one per node, and nodes inserted together
+// end up near each other.  Nodes don't have a parent pointer, which
+// keeps them small (a key, a value, two pointers and a height):
+// instead, the iterators carry the path they came down as a stack.
+// An AVL tree is never more than about 1.44 log2(n) high, so that
+// stack fits in a fixed array and an iterator never allocates (except
+// for the level order one, which needs a queue).
+//
+// Like tree.py there are four orders to walk the tree in: begin() and
+// end() are in order (sorted), and preorder(), postorder() and
+// levelorder() give ranges for the others.
+template <class K, class V = void, class Compare = std::less<K>>
+class OrderedTree
+{
+public:
+    static constexpr bool is_set = std::is_void_v<V>;
+    using key_type = K;
+    using value_type = std::conditional_t<is_set, K, std::pair<const K, V>>;
+
+private:
+    struct Node
+    {
+        template <class... Args>
+        Node(Args &&...args) : value(std::forward<Args>(args)...) {}
+
+        value_type value;
+        Node *left = nullptr;
+        Node *right = nullptr;
+        int8_t height = 1;
+    };
+
+    // Enough for any tree that fits in memory: an AVL tree of height
+    // h has at least fib(h + 2) - 1 nodes, which passes 2^64 before h
+    // gets to 93.
+    static constexpr size_t max_height = 96;
+
+    // The path an iterator has come down.  Only the used part is ever
+    // copied.
+    struct Stack
+    {
+        Stack() {}
+        Stack(const Stack &other) : size(other.size)
+        {
+            std::copy(other.nodes, other.nodes + size, nodes);
+        }
+        Stack &operator=(const Stack &other)
+        {
+            size = other.size;
+            std::copy(other.nodes, other.nodes + size, nodes);
+            return *this;
+        }
+
+        void push(Node *node) { nodes[size++] = node; }
+        Node *pop() { return nodes[--size]; }
+        Node *top() const { return size ? nodes[size - 1] : nullptr; }
+
+        Node *nodes[max_height];
+        uint8_t size = 0;
+    };
+
+public:
+    enum class Order
+    {
+        In,
+        Pre,
+        Post
+    };
+
+    // The three depth-first orders.  In all of them the current node
+    // is on top of the stack.
+    template <Order O, bool Const>
+    class DepthIterator
+    {
+        friend class OrderedTree;
+        template <Order, bool>
+        friend class DepthIterator;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = OrderedTree::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const || is_set, const value_type &, value_type &>;
+        using pointer = std::conditional_t<Const || is_set, const value_type *, value_type *>;
+
+        DepthIterator() {}
+        explicit DepthIterator(Node *root)
+        {
+            if (!root)
+                return;
+            if constexpr (O == Order::In)
+                push_left(root);
+            else if constexpr (O == Order::Pre)
+                path.push(root);
+            else
+                push_first_post(root);
+        }
+        operator DepthIterator<O, true>() const
+        {
+            DepthIterator<O, true> ret;
+            ret.path = path;
+            return ret;
+        }
+
+        reference operator*() const { return path.top()->value; }
+        pointer operator->() const { return &path.top()->value; }
+
+        DepthIterator &operator++()
+        {
+            auto node = path.pop();
+            if constexpr (O == Order::In)
+            {
+                // Below us there's only the nodes whose left subtree
+                // we are in, so next is our right subtree's leftmost,
+                // or failing that the nearest of them.
+                push_left(node->right);
+            }
+            else if constexpr (O == Order::Pre)
+            {
+                if (node->right)
+                    path.push(node->right);
+                if (node->left)
+                    path.push(node->left);
+            }
+            else
+            {
+                // The stack is the path from the root.  After a left
+                // child comes its sibling's subtree; after a right
+                // child (or an only child), the parent.
+                auto parent = path.top();
+                if (parent && parent->left == node && parent->right)
+                    push_first_post(parent->right);
+            }
+            return *this;
+        }
+        DepthIterator operator++(int)
+        {
+            auto ret = *this;
+            ++*this;
+            return ret;
+        }
+        bool operator==(const DepthIterator &other) const { return path.top() == other.path.top(); }
+
+    private:
+        void push_left(Node *node)
+        {
+            for (; node; node = node->left)
+                path.push(node);
+        }
+
+        // The first node in post order is the first leaf you get to
+        // going left whenever you can.
+        void push_first_post(Node *node)
+        {
+            while (node)
+            {
+                path.push(node);
+                node = node->left ? node->left : node->right;
+            }
+        }
+
+        Stack path;
+    };
+
+    // Breadth first, as tree.py's levelorder.  This one needs a queue
+    // as wide as the tree, so it allocates.
+    template <bool Const>
+    class LevelIterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = OrderedTree::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const || is_set, const value_type &, value_type &>;
+        using pointer = std::conditional_t<Const || is_set, const value_type *, value_type *>;
+
+        LevelIterator() {}
+        explicit LevelIterator(Node *root)
+        {
+            if (root)
+                queue.push_back(root);
+        }
+
+        reference operator*() const { return queue.front()->value; }
+        pointer operator->() const { return &queue.front()->value; }
+
+        LevelIterator &operator++()
+        {
+            auto node = queue.front();
+            queue.pop_front();
+            if (node->left)
+                queue.push_back(node->left);
+            if (node->right)
+                queue.push_back(node->right);
+            return *this;
+        }
+        LevelIterator operator++(int)
+        {
+            auto ret = *this;
+            ++*this;
+            return ret;
+        }
+        bool operator==(const LevelIterator &other) const
+        {
+            auto at = queue.empty() ? nullptr : queue.front();
+            auto other_at = other.queue.empty() ? nullptr : other.queue.front();
+            return at == other_at;
+        }
+
+    private:
+        std::deque<Node *> queue;
+    };
+
+    using iterator = DepthIterator<Order::In, false>;
+    using const_iterator = DepthIterator<Order::In, true>;
+
+    OrderedTree() {}
+
+    OrderedTree(std::initializer_list<value_type> values)
+    {
+        for (auto &value : values)
+            insert(value);
+    }
+
+    // A deep copy, of the same shape (so no rebalancing).
+    OrderedTree(const OrderedTree &other) : _less(other._less)
+    {
+        _root = copy(other._root);
+        _size = other._size;
+    }
+
+    OrderedTree &operator=(const OrderedTree &other)
+    {
+        if (&other == this)
+            return *this;
+        clear();
+        _less = other._less;
+        _root = copy(other._root);
+        _size = other._size;
+        return *this;
+    }
+
+    OrderedTree(OrderedTree &&other) noexcept
+        : _pool(std::move(other._pool)),
+          _root(std::exchange(other._root, nullptr)),
+          _size(std::exchange(other._size, 0)),
+          _less(std::move(other._less))
+    {
+    }
+
+    OrderedTree &operator=(OrderedTree &&other) noexcept
+    {
+        if (&other == this)
+            return *this;
+        clear();
+        _pool = std::move(other._pool);
+        _root = std::exchange(other._root, nullptr);
+        _size = std::exchange(other._size, 0);
+        _less = std::move(other._less);
+        return *this;
+    }
+
+    ~OrderedTree() { clear(); }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    // Of the whole tree; 0 when empty.
+    int height() const { return height(_root); }
+
+    // Returns whether it went in (false if the key was already there).
+    bool insert(const value_type &value)
+    {
+        auto before = _size;
+        Node *found;
+        _root = avl_insert(_root, key_of(value), found, [&]
+                           { return _pool.make(value); });
+        return _size != before;
+    }
+
+    // The value for key, inserting a default one if there isn't one,
+    // as std::map's.
+    template <class U = V>
+        requires(!std::is_void_v<U>)
+    U &operator[](const K &key)
+    {
+        Node *found;
+        _root = avl_insert(_root, key, found, [&]
+                           { return _pool.make(std::piecewise_construct, std::forward_as_tuple(key),
+                                               std::forward_as_tuple()); });
+        return found->value.second;
+    }
+
+    template <class U = V>
+        requires(!std::is_void_v<U>)
+    U &at(const K &key)
+    {
+        auto node = find_node(key);
+        if (!node)
+            throw std::out_of_range("Key not found");
+        return node->value.second;
+    }
+
+    template <class U = V>
+        requires(!std::is_void_v<U>)
+    const U &at(const K &key) const
+    {
+        auto node = find_node(key);
+        if (!node)
+            throw std::out_of_range("Key not found");
+        return node->value.second;
+    }
+
+    bool contains(const K &key) const { return find_node(key) != nullptr; }
+
+    // Builds a tree from values in increasing order in O(n), rather
+    // than the O(n log n) (and all the rotations) of inserting them one
+    // at a time.  The nodes are allocated in order and linked up as a
+    // perfectly balanced tree, which is as good an AVL tree as there
+    // is.  Repeated keys are dropped (the first one stays, as with
+    // insert); keys out of order throw std::invalid_argument.
+    template <std::ranges::input_range Range>
+    static OrderedTree from_sorted(Range &&values)
+    {
+        OrderedTree ret;
+        std::vector<Node *> nodes;
+        ret.take_sorted(values, nullptr, nodes);
+        ret._root = link(nodes.data(), nodes.size());
+        ret._size = nodes.size();
+        return ret;
+    }
+
+    // Inserts a batch of values in increasing order by merging them
+    // with the tree's own (in order, so O(n + m)) and linking the lot
+    // up again as in from_sorted.  Keys already in the tree keep their
+    // old entry, and keys out of order throw std::invalid_argument
+    // without changing the tree.  Returns how many went in.
+    //
+    // A batch that's small next to the tree (when we know its size,
+    // and can look at it twice) is cheaper to check and then insert
+    // one at a time, so that's what happens then.
+    template <std::ranges::input_range Range>
+    size_t insert_sorted(Range &&values)
+    {
+        if constexpr (std::ranges::sized_range<Range> && std::ranges::forward_range<Range>)
+        {
+            if ((size_t)std::ranges::size(values) * (size_t)(height() + 1) < _size)
+            {
+                if (!std::ranges::is_sorted(values, _less, [](const auto &value) -> const K &
+                                            { return key_of(value); }))
+                    throw std::invalid_argument("Values not in order");
+                auto before = _size;
+                for (auto &&value : values)
+                {
+                    Node *found;
+                    _root = avl_insert(_root, key_of(value), found, [&]
+                                       { return _pool.make(value); });
+                }
+                return _size - before;
+            }
+        }
+        std::vector<Node *> old, merged;
+        old.reserve(_size);
+        for (auto it = begin(); it != end(); ++it)
+            old.push_back(it.path.top());
+        merged.reserve(_size);
+        take_sorted(values, &old, merged);
+        auto inserted = merged.size() - _size;
+        _root = link(merged.data(), merged.size());
+        _size = merged.size();
+        return inserted;
+    }
+
+    // Returns how many it removed (0 or 1).
+    size_t erase(const K &key)
+    {
+        auto before = _size;
+        _root = avl_erase(_root, key);
+        return before - _size;
+    }
+
+    void clear()
+    {
+        if constexpr (!std::is_trivially_destructible_v<value_type>)
+        {
+            auto walk = postorder();
+            for (auto it = walk.begin(); it != walk.end();)
+            {
+                auto node = it.path.top();
+                ++it;
+                node->~Node();
+            }
+        }
+        _pool.reset();
+        _root = nullptr;
+        _size = 0;
+    }
+
+    // An iterator at key, or end() if it isn't there.
+    iterator find(const K &key) { return search<iterator>(key, true); }
+    const_iterator find(const K &key) const { return search<const_iterator>(key, true); }
+
+    // The first entry whose key is not less than key, and the first
+    // one whose key is greater.  Together they are a range scan.
+    iterator lower_bound(const K &key) { return search<iterator>(key, false); }
+    const_iterator lower_bound(const K &key) const { return search<const_iterator>(key, false); }
+    iterator upper_bound(const K &key) { return bound_above<iterator>(key); }
+    const_iterator upper_bound(const K &key) const { return bound_above<const_iterator>(key); }
+
+    iterator begin() { return iterator(_root); }
+    iterator end() { return iterator(); }
+    const_iterator begin() const { return const_iterator(_root); }
+    const_iterator end() const { return const_iterator(); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    auto preorder() const
+    {
+        using It = DepthIterator<Order::Pre, true>;
+        return std::ranges::subrange(It(_root), It());
+    }
+    auto postorder() const
+    {
+        using It = DepthIterator<Order::Post, true>;
+        return std::ranges::subrange(It(_root), It());
+    }
+    auto levelorder() const
+    {
+        using It = LevelIterator<true>;
+        return std::ranges::subrange(It(_root), It());
+    }
+
+    // Checks every node's height and balance, like orderedtree.py's
+    // assert_correct_balance (for tests).
+    bool is_balanced() const
+    {
+        bool ok = true;
+        check_balance(_root, ok);
+        return ok;
+    }
+
+private:
+    static const K &key_of(const value_type &value)
+    {
+        if constexpr (is_set)
+            return value;
+        else
+            return value.first;
+    }
+
+    static int height(const Node *node) { return node ? node->height : 0; }
+    static int balance(const Node *node) { return height(node->right) - height(node->left); }
+    static void update_height(Node *node)
+    {
+        node->height = (int8_t)(1 + std::max(height(node->left), height(node->right)));
+    }
+
+    static Node *rotate_left(Node *node)
+    {
+        auto new_top = node->right;
+        node->right = new_top->left;
+        new_top->left = node;
+        update_height(new_top->left);
+        update_height(new_top);
+        return new_top;
+    }
+
+    static Node *rotate_right(Node *node)
+    {
+        auto new_top = node->left;
+        node->left = new_top->right;
+        new_top->right = node;
+        update_height(new_top->right);
+        update_height(new_top);
+        return new_top;
+    }
+
+    static Node *avl_rebalance(Node *node)
+    {
+        auto b = balance(node);
+        if (b == 2)
+        {
+            // Right heavy.  Is our right subtree left heavy?
+            if (balance(node->right) == -1)
+                node->right = rotate_right(node->right);
+            return rotate_left(node);
+        }
+        if (b == -2)
+        {
+            if (balance(node->left) == 1)
+                node->left = rotate_left(node->left);
+            return rotate_right(node);
+        }
+        return node;
+    }
+
+    // Recursive like the Python, but only as deep as the tree is
+    // high.  found is the node for key, new (from make) or not.
+    template <class Make>
+    Node *avl_insert(Node *node, const K &key, Node *&found, const Make &make)
+    {
+        if (!node)
+        {
+            found = make();
+            _size++;
+            return found;
+        }
+        // Only store the child if it changed, so that nodes above the
+        // change aren't written to (and their cache lines dirtied).
+        Node *child;
+        if (_less(key, key_of(node->value)))
+        {
+            child = avl_insert(node->left, key, found, make);
+            if (child != node->left)
+                node->left = child;
+        }
+        else if (_less(key_of(node->value), key))
+        {
+            child = avl_insert(node->right, key, found, make);
+            if (child != node->right)
+                node->right = child;
+        }
+        else
+        {
+            found = node;
+            return node;
+        }
+        // While we're still taller than the subtree that grew, our
+        // height hasn't changed, and neither has anything above us.
+        // (Nor can we be out of balance: we were leaning away from
+        // it, and now we aren't.)  That saves looking at the other
+        // subtree, which is usually a cache miss.
+        if (child->height < node->height)
+            return node;
+        update_height(node);
+        return avl_rebalance(node);
+    }
+
+    // Unhooks the smallest node of the subtree into min, returning
+    // what's left of the subtree.
+    static Node *remove_min(Node *node, Node *&min)
+    {
+        if (!node->left)
+        {
+            min = node;
+            return node->right;
+        }
+        node->left = remove_min(node->left, min);
+        update_height(node);
+        return avl_rebalance(node);
+    }
+
+    Node *avl_erase(Node *node, const K &key)
+    {
+        if (!node)
+            return nullptr;
+        if (_less(key, key_of(node->value)))
+            node->left = avl_erase(node->left, key);
+        else if (_less(key_of(node->value), key))
+            node->right = avl_erase(node->right, key);
+        else
+        {
+            // A node with two children is replaced by the smallest
+            // one on its right, which has at most one.
+            Node *replacement = node->left;
+            if (node->right)
+            {
+                Node *min;
+                auto right = remove_min(node->right, min);
+                min->left = node->left;
+                min->right = right;
+                replacement = min;
+            }
+            _pool.destroy(node);
+            _size--;
+            if (!replacement)
+                return nullptr;
+            node = replacement;
+        }
+        update_height(node);
+        return avl_rebalance(node);
+    }
+
+    Node *find_node(const K &key) const
+    {
+        auto node = _root;
+        while (node)
+        {
+            if (_less(key, key_of(node->value)))
+                node = node->left;
+            else if (_less(key_of(node->value), key))
+                node = node->right;
+            else
+                return node;
+        }
+        return nullptr;
+    }
+
+    // On the way down, every node we go left at is one we'll come
+    // back to, so it goes on the stack, which leaves the iterator
+    // exactly as if it had got there with ++.
+    template <class It>
+    It search(const K &key, bool exact) const
+    {
+        It ret;
+        auto node = _root;
+        while (node)
+        {
+            if (_less(key_of(node->value), key))
+                node = node->right;
+            else
+            {
+                ret.path.push(node);
+                if (!_less(key, key_of(node->value)))
+                    return ret;
+                node = node->left;
+            }
+        }
+        return exact ? It() : ret;
+    }
+
+    template <class It>
+    It bound_above(const K &key) const
+    {
+        It ret;
+        auto node = _root;
+        while (node)
+        {
+            if (_less(key, key_of(node->value)))
+            {
+                ret.path.push(node);
+                node = node->left;
+            }
+            else
+                node = node->right;
+        }
+        return ret;
+    }
+
+    // Makes nodes for values (which must be in order) and merges them
+    // into out with the nodes of existing (if any), which are already
+    // in order.  On an error the new nodes are freed, and nothing else
+    // has changed.
+    template <class Range>
+    void take_sorted(Range &&values, const std::vector<Node *> *existing, std::vector<Node *> &out)
+    {
+        std::vector<Node *> added;
+        size_t next = 0;
+        auto old_left = [&]
+        { return existing && next < existing->size(); };
+        const K *last = nullptr;
+        try
+        {
+            for (auto &&value : values)
+            {
+                const K &key = key_of(value);
+                if (last && _less(key, *last))
+                    throw std::invalid_argument("Values not in order");
+                if (last && !_less(*last, key))
+                    continue;
+                while (old_left() && _less(key_of((*existing)[next]->value), key))
+                    out.push_back((*existing)[next++]);
+                if (old_left() && !_less(key, key_of((*existing)[next]->value)))
+                {
+                    last = &key_of((*existing)[next]->value);
+                    continue;
+                }
+                auto node = _pool.make(value);
+                added.push_back(node);
+                out.push_back(node);
+                last = &key_of(node->value);
+            }
+        }
+        catch (...)
+        {
+            for (auto node : added)
+                _pool.destroy(node);
+            throw;
+        }
+        while (old_left())
+            out.push_back((*existing)[next++]);
+    }
+
+    // Links nodes (in order) into a perfectly balanced tree: the
+    // middle one at the top, and each half the same way below it.
+    static Node *link(Node **nodes, size_t count)
+    {
+        if (count == 0)
+            return nullptr;
+        auto mid = count / 2;
+        auto node = nodes[mid];
+        node->left = link(nodes, mid);
+        node->right = link(nodes + mid + 1, count - mid - 1);
+        update_height(node);
+        return node;
+    }
+
+    Node *copy(const Node *from)
+    {
+        if (!from)
+            return nullptr;
+        auto node = _pool.make(from->value);
+        node->height = from->height;
+        node->left = copy(from->left);
+        node->right = copy(from->right);
+        return node;
+    }
+
+    void check_balance(const Node *node, bool &ok) const
+    {
+        if (!node)
+            return;
+        check_balance(node->left, ok);
+        check_balance(node->right, ok);
+        if (node->height != 1 + std::max(height(node->left), height(node->right)))
+            ok = false;
+        if (balance(node) < -1 || balance(node) > 1)
+            ok = false;
+    }
+
+    ObjectPool<Node> _pool;
+    Node *_root = nullptr;
+    size_t _size = 0;
+    [[no_unique_address]] Compare _less;
+};
+
+template <class K, class V, class Compare = std::less<K>>
+using OrderedMap = OrderedTree<K, V, Compare>;
+
+template <class K, class Compare = std::less<K>>
+using OrderedSet = OrderedTree<K, void, Compare>;
+
+#endif
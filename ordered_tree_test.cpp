@@ -0,0 +1,279 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <ranges>
+#include <string>
+#include <vector>
+#include "ordered_tree.hpp"
+
+template <class Range>
+std::vector<int> collect(const Range &range)
+{
+    std::vector<int> ret;
+    for (auto x : range)
+        ret.push_back(x);
+    return ret;
+}
+
+TEST(OrderedTree, SameShapeAsPython)
+{
+    // orderedtree.py's avl_testing: inserting 1 to 9 in order.
+    OrderedSet<int> test{1, 2, 3, 4, 5, 6, 7, 8, 9};
+    EXPECT_TRUE(test.is_balanced());
+    EXPECT_EQ(test.size(), 9u);
+    EXPECT_EQ(test.height(), 4);
+    EXPECT_EQ(collect(test), (std::vector<int>{1, 2, 3, 4, 5, 6, 7, 8, 9}));
+    EXPECT_EQ(collect(test.preorder()), (std::vector<int>{4, 2, 1, 3, 6, 5, 8, 7, 9}));
+    EXPECT_EQ(collect(test.postorder()), (std::vector<int>{1, 3, 2, 5, 7, 9, 8, 6, 4}));
+    EXPECT_EQ(collect(test.levelorder()), (std::vector<int>{4, 2, 6, 1, 3, 5, 8, 7, 9}));
+
+    // And its full_test: the even numbers, shuffled.
+    std::vector<int> data;
+    for (auto x = 0; x < 80; x += 2)
+        data.push_back(x);
+    std::shuffle(data.begin(), data.end(), std::mt19937(7));
+    OrderedSet<int> evens;
+    for (auto x : data)
+        EXPECT_TRUE(evens.insert(x));
+    EXPECT_FALSE(evens.insert(4));
+    EXPECT_EQ(evens.size(), 40u);
+    for (auto x = -1; x < 80; ++x)
+        EXPECT_EQ(evens.contains(x), x % 2 == 0);
+    EXPECT_TRUE(std::ranges::is_sorted(evens));
+    EXPECT_TRUE(evens.is_balanced());
+
+    OrderedSet<int> empty;
+    EXPECT_EQ(empty.begin(), empty.end());
+    EXPECT_TRUE(collect(empty.preorder()).empty());
+    EXPECT_TRUE(collect(empty.postorder()).empty());
+    EXPECT_TRUE(collect(empty.levelorder()).empty());
+    EXPECT_EQ(empty.height(), 0);
+}
+
+TEST(OrderedTree, Map)
+{
+    OrderedMap<std::string, int> counts;
+    for (auto word : {"the", "cat", "sat", "on", "the", "mat", "the", "end"})
+        counts[word]++;
+    EXPECT_EQ(counts.size(), 6u);
+    EXPECT_EQ(counts.at("the"), 3);
+    EXPECT_EQ(counts.at("cat"), 1);
+    EXPECT_THROW(counts.at("dog"), std::out_of_range);
+    EXPECT_FALSE(counts.insert({"cat", 10}));
+    EXPECT_TRUE(counts.insert({"dog", 10}));
+    EXPECT_EQ(counts.at("cat"), 1);
+
+    std::string keys;
+    for (auto &[key, count] : counts)
+    {
+        keys += key + " ";
+        count = 0;
+    }
+    EXPECT_EQ(keys, "cat dog end mat on sat the ");
+    EXPECT_EQ(counts.at("the"), 0);
+
+    auto it = counts.find("mat");
+    ASSERT_NE(it, counts.end());
+    EXPECT_EQ(it->first, "mat");
+    // find leaves an iterator that carries on in order.
+    ++it;
+    EXPECT_EQ(it->first, "on");
+    EXPECT_EQ(counts.find("cow"), counts.end());
+
+    // A range scan: [d, o).
+    keys.clear();
+    for (auto at = counts.lower_bound("d"); at != counts.lower_bound("o"); ++at)
+        keys += at->first + " ";
+    EXPECT_EQ(keys, "dog end mat ");
+    EXPECT_EQ(counts.upper_bound("on")->first, "sat");
+    EXPECT_EQ(counts.lower_bound("on")->first, "on");
+    EXPECT_EQ(counts.lower_bound("zzz"), counts.end());
+    EXPECT_EQ(counts.upper_bound("the"), counts.end());
+
+    // Copies are deep, and moves leave the source empty.
+    auto copy = counts;
+    copy["cat"] = 5;
+    EXPECT_EQ(counts.at("cat"), 0);
+    EXPECT_EQ(copy.size(), counts.size());
+    EXPECT_TRUE(copy.is_balanced());
+    auto moved = std::move(copy);
+    EXPECT_EQ(moved.at("cat"), 5);
+    EXPECT_EQ(copy.size(), 0u);
+    copy = moved;
+    EXPECT_EQ(copy.at("cat"), 5);
+    moved.clear();
+    EXPECT_TRUE(moved.empty());
+    moved["again"] = 1;
+    EXPECT_EQ(moved.size(), 1u);
+}
+
+TEST(OrderedTree, EraseAgainstStdMap)
+{
+    std::mt19937 random(1);
+    OrderedMap<int, int> tree;
+    std::map<int, int> reference;
+    for (auto i = 0; i < 20000; ++i)
+    {
+        auto key = (int)(random() % 2000);
+        if (random() % 3 == 0)
+        {
+            EXPECT_EQ(tree.erase(key), reference.erase(key));
+        }
+        else
+        {
+            tree[key] = i;
+            reference[key] = i;
+        }
+        if (i % 1000 == 0)
+        {
+            EXPECT_TRUE(tree.is_balanced());
+        }
+    }
+    EXPECT_TRUE(tree.is_balanced());
+    ASSERT_EQ(tree.size(), reference.size());
+    auto expected = reference.begin();
+    for (auto &[key, value] : tree)
+    {
+        EXPECT_EQ(key, expected->first);
+        EXPECT_EQ(value, expected->second);
+        ++expected;
+    }
+    for (auto &[key, value] : reference)
+        EXPECT_EQ(tree.erase(key), 1u);
+    EXPECT_TRUE(tree.empty());
+    EXPECT_EQ(tree.begin(), tree.end());
+}
+
+TEST(OrderedTree, BulkLoad)
+{
+    std::vector<int> sorted(1000);
+    std::iota(sorted.begin(), sorted.end(), 0);
+    auto tree = OrderedSet<int>::from_sorted(sorted);
+    EXPECT_EQ(tree.size(), 1000u);
+    EXPECT_TRUE(tree.is_balanced());
+    // Perfectly balanced: 1000 fits in 10 levels.
+    EXPECT_EQ(tree.height(), 10);
+    EXPECT_TRUE(std::ranges::equal(tree, sorted));
+    EXPECT_EQ(collect(OrderedSet<int>::from_sorted(std::vector<int>{1, 2, 3}).preorder()),
+              (std::vector<int>{2, 1, 3}));
+    EXPECT_TRUE(OrderedSet<int>::from_sorted(std::vector<int>()).empty());
+
+    // Repeats are dropped, out of order throws.
+    auto repeats = OrderedSet<int>::from_sorted(std::vector<int>{1, 1, 2, 3, 3, 3});
+    EXPECT_EQ(collect(repeats), (std::vector<int>{1, 2, 3}));
+    EXPECT_THROW(OrderedSet<int>::from_sorted(std::vector<int>{1, 3, 2}), std::invalid_argument);
+    using Strings = OrderedSet<std::string>;
+    EXPECT_THROW(Strings::from_sorted(std::vector<std::string>{"a", "c", "b"}),
+                 std::invalid_argument);
+
+    // Any input range will do, and maps work the same way.
+    auto squares = OrderedMap<int, int>::from_sorted(
+        std::views::iota(0, 100) | std::views::transform([](int i)
+                                                         { return std::pair<const int, int>(i, i * i); }));
+    EXPECT_EQ(squares.at(12), 144);
+    squares[1000] = 1;
+    EXPECT_TRUE(squares.is_balanced());
+
+    // Merging a big batch: the odd numbers into the evens, with some
+    // that are already there (those keep the old value).
+    OrderedMap<int, std::string> merged;
+    for (auto i = 0; i < 200; i += 2)
+        merged[i] = "old";
+    std::vector<std::pair<const int, std::string>> batch;
+    for (auto i = 0; i < 300; i += 1)
+    {
+        if (i % 2 || i % 10 == 0)
+            batch.emplace_back(i, "new");
+    }
+    EXPECT_EQ(merged.insert_sorted(batch), 150u + 10u);
+    EXPECT_EQ(merged.size(), 260u);
+    EXPECT_TRUE(merged.is_balanced());
+    EXPECT_EQ(merged.at(10), "old");
+    EXPECT_EQ(merged.at(11), "new");
+    EXPECT_EQ(merged.at(250), "new");
+    std::vector<int> keys, expected;
+    for (auto &[key, value] : merged)
+        keys.push_back(key);
+    for (auto i = 0; i < 300; ++i)
+    {
+        if (i < 200 || i % 2 || i % 10 == 0)
+            expected.push_back(i);
+    }
+    EXPECT_EQ(keys, expected);
+
+    // A batch out of order leaves the tree as it was.
+    std::vector<std::pair<const int, std::string>> bad;
+    bad.emplace_back(1000, "x");
+    bad.emplace_back(999, "x");
+    EXPECT_THROW(merged.insert_sorted(std::views::all(bad) | std::views::filter([](auto &)
+                                                                                { return true; })),
+                 std::invalid_argument);
+    EXPECT_EQ(merged.size(), 260u);
+    EXPECT_FALSE(merged.contains(1000));
+
+    // A small batch goes in one at a time.
+    auto big = OrderedSet<int>::from_sorted(sorted);
+    EXPECT_EQ(big.insert_sorted(std::vector<int>{-2, -1, 5, 2000}), 3u);
+    EXPECT_EQ(big.size(), 1003u);
+    EXPECT_TRUE(big.is_balanced());
+    // Out of order throws before anything goes in, as a big batch does.
+    EXPECT_THROW(big.insert_sorted(std::vector<int>{3000, 3001, 2999}), std::invalid_argument);
+    EXPECT_EQ(big.size(), 1003u);
+    EXPECT_FALSE(big.contains(3000));
+}
+
+// Not really a test: building a tree from sorted keys, one insert at
+// a time and with from_sorted.
+TEST(OrderedTree, DISABLED_BulkLoadBenchmark)
+{
+    const int n = 2000000;
+    std::vector<int> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    auto start = std::chrono::steady_clock::now();
+    OrderedSet<int> inserted;
+    for (auto k : keys)
+        inserted.insert(k);
+    auto middle = std::chrono::steady_clock::now();
+    auto loaded = OrderedSet<int>::from_sorted(keys);
+    auto finish = std::chrono::steady_clock::now();
+    EXPECT_EQ(inserted.size(), loaded.size());
+    EXPECT_TRUE(loaded.is_balanced());
+    std::cout << n << " sorted keys: inserts " << std::chrono::duration<double>(middle - start).count()
+              << "s, from_sorted " << std::chrono::duration<double>(finish - middle).count() << "s\n";
+}
+
+// Not really a test: inserts and lookups of random keys against
+// std::map.
+TEST(OrderedTree, DISABLED_Benchmark)
+{
+    const int n = 500000;
+    std::vector<int> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(3));
+    auto time = [](auto f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    OrderedSet<int> tree;
+    std::map<int, bool> map;
+    auto tree_insert = time([&]
+                            { for (auto k : keys) tree.insert(k); });
+    auto map_insert = time([&]
+                           { for (auto k : keys) map[k] = true; });
+    size_t tree_found = 0, map_found = 0;
+    auto tree_lookup = time([&]
+                            { for (auto k : keys) tree_found += tree.contains(k); });
+    auto map_lookup = time([&]
+                           { for (auto k : keys) map_found += map.contains(k); });
+    EXPECT_EQ(tree_found, (size_t)n);
+    EXPECT_EQ(map_found, (size_t)n);
+    EXPECT_TRUE(tree.is_balanced());
+    std::cout << n << " inserts: OrderedTree " << tree_insert << "s, std::map " << map_insert << "s\n"
+              << n << " lookups: OrderedTree " << tree_lookup << "s, std::map " << map_lookup << "s\n";
+}
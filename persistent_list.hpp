@@ -0,0 +1,219 @@
+#ifndef PERSISTENT_LIST_HPP
+#define PERSISTENT_LIST_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "llist.hpp"
+
+// An immutable list, where "changing" it gives you a new version and
+// leaves the old one as it was (a persistent data structure, as in
+// functional languages).
+//
+// Since nothing is ever modified, versions can share cells: prepend
+// makes one new cell whose _next is the old list, so the new version
+// is one cell plus everything the old one already had.  Copying is
+// O(1), since it's just another pointer to the same head.  A set(i)
+// copies the first i cells and shares the rest.  So keeping
+// thousands of versions that differ a little costs memory for the
+// differences, not for thousands of whole lists.
+//
+// The flip side is that the only cheap end is the front: there is no
+// append, since adding at the end would mean copying every cell.
+//
+// Cells are freed when the last version using them goes, and that
+// happens in a loop, like LinkedList::clear(), so dropping the last
+// version of a long list doesn't recurse down it.
+template <class T>
+class PersistentList
+{
+    // The same cells LinkedList uses, so that we can take a whole
+    // list's over without copying them.
+    using Cell = LinkedListCell<T>;
+
+public:
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using reference = const T &;
+        using pointer = const T *;
+
+        Iterator() {}
+        explicit Iterator(const Cell *at) : _at(at) {}
+
+        const T &operator*() const { return _at->_data; }
+        const T *operator->() const { return &_at->_data; }
+        Iterator &operator++()
+        {
+            _at = _at->_next.get();
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            auto ret = *this;
+            _at = _at->_next.get();
+            return ret;
+        }
+        bool operator==(const Iterator &other) const { return _at == other._at; }
+
+    private:
+        const Cell *_at = nullptr;
+    };
+
+    PersistentList() {}
+
+    // Copies the elements (it has to: a LinkedList's cells can change
+    // under us), in O(n).
+    explicit PersistentList(const LinkedList<T> &from)
+    {
+        std::vector<const T *> items;
+        for (auto at = from.cbegin(); at != from.cend(); ++at)
+            items.push_back(&*at);
+        for (auto i = items.size(); i-- > 0;)
+            push(*items[i]);
+    }
+
+    // Takes the cells over, in O(1): nothing else can change them once
+    // from has let go of them.  from is left empty.
+    explicit PersistentList(LinkedList<T> &&from)
+        : _head(std::move(from._head)), _len(std::exchange(from._len, 0))
+    {
+        from._tail = nullptr;
+        from.forget_positions();
+    }
+
+    PersistentList(const PersistentList &) = default;
+    PersistentList(PersistentList &&other) noexcept
+        : _head(std::move(other._head)), _len(std::exchange(other._len, 0))
+    {
+    }
+    PersistentList &operator=(const PersistentList &other)
+    {
+        if (&other == this)
+            return *this;
+        release();
+        _head = other._head;
+        _len = other._len;
+        return *this;
+    }
+    PersistentList &operator=(PersistentList &&other) noexcept
+    {
+        if (&other == this)
+            return *this;
+        release();
+        _head = std::move(other._head);
+        _len = std::exchange(other._len, 0);
+        return *this;
+    }
+
+    ~PersistentList() { release(); }
+
+    size_t len() const { return _len; }
+    bool empty() const { return _len == 0; }
+
+    // A new version with data on the front, sharing all of this one.
+    PersistentList prepend(const T &data) const
+    {
+        PersistentList ret(*this);
+        ret.push(data);
+        return ret;
+    }
+
+    const T &front() const
+    {
+        if (!_head)
+            throw SliceException("Index out of range");
+        return _head->_data;
+    }
+
+    // Everything but the front, in O(1).
+    PersistentList rest() const { return drop(1); }
+
+    // Everything but the first n.  O(n) to walk there, but no copying.
+    PersistentList drop(size_t n) const
+    {
+        if (n > _len)
+            throw SliceException("Index out of range");
+        if (n == 0)
+            return *this;
+        // Walk with plain pointers, so as not to bump reference counts
+        // on the way.
+        auto before = _head.get();
+        for (size_t i = 1; i < n; ++i)
+            before = before->_next.get();
+        PersistentList ret;
+        ret._head = before->_next;
+        ret._len = _len - n;
+        return ret;
+    }
+
+    const T &operator[](size_t location) const
+    {
+        if (location >= _len)
+            throw SliceException("Index out of range");
+        auto at = _head.get();
+        for (; location > 0; --location)
+            at = at->_next.get();
+        return at->_data;
+    }
+
+    // A new version with element location replaced.  The cells before
+    // it are copied and everything after it is shared.
+    PersistentList set(size_t location, const T &data) const
+    {
+        if (location >= _len)
+            throw SliceException("Index out of range");
+        std::vector<const T *> before;
+        auto at = _head.get();
+        for (; before.size() < location; at = at->_next.get())
+            before.push_back(&at->_data);
+        PersistentList ret;
+        ret._head = at->_next;
+        ret._len = _len - location - 1;
+        ret.push(data);
+        for (auto i = before.size(); i-- > 0;)
+            ret.push(*before[i]);
+        return ret;
+    }
+
+    // Copies the elements out into an ordinary (mutable) list.
+    LinkedList<T> to_linked_list() const
+    {
+        LinkedList<T> ret;
+        for (auto &x : *this)
+            ret.append(x);
+        return ret;
+    }
+
+    Iterator begin() const { return Iterator(_head.get()); }
+    Iterator end() const { return Iterator(); }
+    Iterator cbegin() const { return begin(); }
+    Iterator cend() const { return end(); }
+
+private:
+    void push(const T &data)
+    {
+        _head = std::make_shared<Cell>(data, std::move(_head));
+        _len++;
+    }
+
+    // Drops our hold on the cells.  Any we were the last user of go in
+    // a loop; we stop at the first one some other version still uses.
+    void release()
+    {
+        auto at = std::move(_head);
+        while (at && at.use_count() == 1)
+            at = std::move(at->_next);
+        _len = 0;
+    }
+
+    std::shared_ptr<Cell> _head;
+    size_t _len = 0;
+};
+
+#endif
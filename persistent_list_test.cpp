@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "persistent_list.hpp"
+
+TEST(PersistentList, Versions)
+{
+    PersistentList<int> empty;
+    EXPECT_EQ(empty.len(), 0u);
+    EXPECT_THROW(empty.front(), SliceException);
+
+    auto one = empty.prepend(1);
+    auto two = one.prepend(2);
+    auto other = one.prepend(20);
+    // Old versions are untouched.
+    EXPECT_EQ(to_string(empty), "[]");
+    EXPECT_EQ(to_string(one), "[1]");
+    EXPECT_EQ(to_string(two), "[2, 1]");
+    EXPECT_EQ(to_string(other), "[20, 1]");
+    // and share what they have in common.
+    EXPECT_EQ(&two[1], &one[0]);
+    EXPECT_EQ(&other[1], &one[0]);
+    EXPECT_EQ(&two.rest().front(), &one.front());
+
+    // Copies are the same cells.
+    auto copy = two;
+    EXPECT_EQ(&copy[0], &two[0]);
+
+    PersistentList<std::string> config;
+    for (auto i = 9; i >= 0; --i)
+        config = config.prepend("v" + std::to_string(i));
+    auto changed = config.set(3, "changed");
+    EXPECT_EQ(config[3], "v3");
+    EXPECT_EQ(changed[3], "changed");
+    EXPECT_EQ(changed.len(), 10u);
+    // Before the change is copied, after it is shared.
+    EXPECT_NE(&changed[2], &config[2]);
+    EXPECT_EQ(&changed[4], &config[4]);
+    EXPECT_EQ(&changed[9], &config[9]);
+    EXPECT_THROW(config.set(10, "x"), SliceException);
+
+    auto tail = config.drop(7);
+    EXPECT_EQ(to_string(tail), "[v7, v8, v9]");
+    EXPECT_EQ(config.drop(10).len(), 0u);
+    EXPECT_THROW(config.drop(11), SliceException);
+}
+
+TEST(PersistentList, ToAndFromLinkedList)
+{
+    LinkedList<int> mutable_list;
+    for (auto i = 0; i < 5; ++i)
+        mutable_list.append(i);
+    PersistentList<int> frozen(mutable_list);
+    mutable_list[0] = 100;
+    EXPECT_EQ(to_string(frozen), "[0, 1, 2, 3, 4]");
+    auto back = frozen.to_linked_list();
+    back[1] = 100;
+    EXPECT_EQ(to_string(back), "[0, 100, 2, 3, 4]");
+    EXPECT_EQ(frozen[1], 1);
+
+    // Handing the list over moves its cells rather than copying them.
+    const int *first = &mutable_list[0];
+    PersistentList<int> adopted(std::move(mutable_list));
+    EXPECT_EQ(&adopted.front(), first);
+    EXPECT_EQ(to_string(adopted), "[100, 1, 2, 3, 4]");
+    EXPECT_EQ(mutable_list.len(), 0u);
+    mutable_list.append(7);
+    EXPECT_EQ(to_string(mutable_list), "[7]");
+    EXPECT_EQ(adopted.len(), 5u);
+}
+
+TEST(PersistentList, ManyVersionsAndTeardown)
+{
+    // A long list, and a thousand versions of it that each differ in
+    // one of the first few elements: each of those only costs a few
+    // cells.
+    PersistentList<int> base;
+    for (auto i = 0; i < 1000000; ++i)
+        base = base.prepend(i);
+    std::vector<PersistentList<int>> history;
+    for (auto i = 0; i < 1000; ++i)
+        history.push_back(base.set((size_t)(i % 5), -i));
+    EXPECT_EQ(history[999][4], -999);
+    EXPECT_EQ(&history[999][5], &base[5]);
+    // Dropping everything mustn't recurse down the million cells.
+    history.clear();
+    base = PersistentList<int>();
+    EXPECT_EQ(base.len(), 0u);
+}
@@ -0,0 +1,434 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <memory>
+#include <vector>
+#include <map>
+#include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include "workqueue.hpp"
+
+// A chain of stages connected by bounded WorkQueues, each stage run by
+// its own set of threads:
+//
+//    auto p = Pipeline<std::string>(64)
+//                 .stage("parse", 4, [](std::string s) { return parse(s); })
+//                 .stage("score", 8, [](Record r) { return score(r); },
+//                        PipelineOrder::Ordered);
+//    std::jthread feeder([&]() { for (...) p.put(line); p.close(); });
+//    while (auto x = p.next()) ...
+//
+// Every stage takes one input to one output.  The queues between stages
+// are bounded, so a slow stage makes the stages in front of it wait
+// (back-pressure) rather than pile up data.
+//
+// End of stream: close() closes the input queue.  The first stage's
+// workers drain it and exit, and the last one out closes the next
+// queue, and so on down the line, until next() reports the end.
+//
+// Every item carries the sequence number it was given by put().  An
+// Ordered stage puts its output back into that order before passing it
+// on (so a slow item holds up the ones behind it); an Unordered stage
+// passes things on as soon as they are done.  An Ordered stage only
+// works on items within capacity of the oldest one it is waiting for,
+// so a slow item can't make everything behind it pile up while it
+// waits: the stage stops taking input, and back-pressure does the rest.
+//
+// If a stage throws, the whole pipeline is shut down and the exception
+// comes back out of put(), get() or next().  Destroying a pipeline
+// also shuts it down: workers finish the item they are on, and
+// anything still queued is thrown away without being processed.
+enum class PipelineOrder
+{
+    Unordered,
+    Ordered
+};
+
+struct PipelineStageStats
+{
+    std::string name;
+    size_t workers;
+    // Items this stage has finished.
+    uint64_t items;
+    // Time spent inside the stage function, over all its workers.
+    double busy_seconds;
+    // Since the stage started.
+    double elapsed_seconds;
+    // Items waiting in front of this stage right now.
+    size_t queue_depth;
+
+    double items_per_second() const
+    {
+        return elapsed_seconds > 0 ? (double)items / elapsed_seconds : 0;
+    }
+};
+
+// The pieces Pipeline is built from.  They live outside the class
+// because Pipeline<In, A> and Pipeline<In, B> need to share them.
+template <class U>
+struct PipelineItem
+{
+    uint64_t sequence;
+    U value;
+};
+
+template <class U>
+using PipelineQueue = WorkQueue<PipelineItem<U>>;
+
+struct PipelineStage
+{
+    std::string name;
+    size_t workers;
+    std::atomic<size_t> live;
+    std::atomic<uint64_t> items = 0;
+    std::atomic<uint64_t> busy_ns = 0;
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    std::function<size_t()> depth;
+};
+
+// Holds finished items until everything before them is done too.
+//
+// The window keeps that bounded: a worker that takes an item window or
+// more past next waits (in admit) for next to catch up, rather than
+// adding to the pile.  Except that the last worker not waiting never
+// does: next might still be in the queue behind what they hold (if an
+// earlier Unordered stage shuffled things), and somebody has to go and
+// get it.
+//
+// The items that are ready go out with the lock released, so a full
+// downstream queue only holds up the one worker putting them, not all
+// the others trying to finish theirs.  Only one worker at a time does
+// that (flushing), which keeps the puts in order.
+template <class U>
+struct PipelineReorder
+{
+    PipelineReorder(size_t window, size_t workers) : window(window), workers(workers) {}
+
+    std::mutex lock;
+    std::condition_variable moved;
+    uint64_t next = 0;
+    size_t window;
+    size_t workers;
+    size_t blocked = 0;
+    bool flushing = false;
+    bool closed = false;
+    std::map<uint64_t, U> waiting;
+
+    // Before starting on sequence: waits until it is inside the window.
+    void admit(uint64_t sequence)
+    {
+        std::unique_lock l(lock);
+        while (!closed && sequence >= next + window && blocked + 1 < workers)
+        {
+            blocked++;
+            moved.wait(l);
+            blocked--;
+        }
+    }
+
+    void emit(PipelineItem<U> item, PipelineQueue<U> &to)
+    {
+        std::unique_lock l(lock);
+        waiting.emplace(item.sequence, std::move(item.value));
+        if (flushing)
+            return; // Whoever is flushing will get to it.
+        flushing = true;
+        try
+        {
+            std::vector<PipelineItem<U>> ready;
+            while (!waiting.empty() && waiting.begin()->first == next)
+            {
+                while (!waiting.empty() && waiting.begin()->first == next)
+                {
+                    ready.push_back(PipelineItem<U>{next, std::move(waiting.begin()->second)});
+                    waiting.erase(waiting.begin());
+                    next++;
+                }
+                l.unlock();
+                moved.notify_all();
+                for (auto &r : ready)
+                    to.put(std::move(r));
+                ready.clear();
+                l.lock();
+            }
+        }
+        catch (...)
+        {
+            if (!l.owns_lock())
+                l.lock();
+            flushing = false;
+            throw;
+        }
+        flushing = false;
+    }
+
+    // Shutting down: nobody waits for the window any more.
+    void close()
+    {
+        {
+            std::unique_lock l(lock);
+            closed = true;
+        }
+        moved.notify_all();
+    }
+};
+
+// Everything that doesn't depend on the types at the ends, so it
+// can be handed along as the pipeline grows.  The worker threads
+// point at it, so it stays put (behind a unique_ptr) when the
+// Pipeline object moves.
+struct PipelineShared
+{
+    size_t capacity;
+    std::atomic<uint64_t> next_sequence = 0;
+    // Set when shutting down (rather than just at the end of the
+    // input), so workers stop taking items.
+    std::atomic<bool> stopping = false;
+
+    std::mutex lock;
+    std::exception_ptr error;
+    std::vector<std::function<void()>> closers;
+    std::vector<std::shared_ptr<PipelineStage>> stages;
+    std::vector<std::jthread> threads;
+
+    // Closes every queue, which makes every worker exit, and then
+    // joins them.  The threads have to go first since they use the
+    // rest of this.
+    ~PipelineShared()
+    {
+        stopping = true;
+        close_all();
+        threads.clear();
+    }
+
+    void add_closer(std::function<void()> closer)
+    {
+        std::unique_lock l(lock);
+        closers.push_back(std::move(closer));
+    }
+
+    void add_stats(std::shared_ptr<PipelineStage> stats)
+    {
+        std::unique_lock l(lock);
+        stages.push_back(std::move(stats));
+    }
+
+    void add_thread(std::jthread t)
+    {
+        std::unique_lock l(lock);
+        threads.push_back(std::move(t));
+    }
+
+    void close_all()
+    {
+        std::vector<std::function<void()>> todo;
+        {
+            std::unique_lock l(lock);
+            todo = closers;
+        }
+        for (auto &c : todo)
+            c();
+    }
+
+    void fail(std::exception_ptr e)
+    {
+        {
+            std::unique_lock l(lock);
+            if (!error)
+                error = e;
+        }
+        stopping = true;
+        close_all();
+    }
+
+    void rethrow_error()
+    {
+        std::exception_ptr e;
+        {
+            std::unique_lock l(lock);
+            e = error;
+        }
+        if (e)
+            std::rethrow_exception(e);
+    }
+
+    std::vector<PipelineStageStats> snapshot()
+    {
+        std::unique_lock l(lock);
+        std::vector<PipelineStageStats> ret;
+        auto now = std::chrono::steady_clock::now();
+        for (auto &s : stages)
+        {
+            ret.push_back(PipelineStageStats{
+                s->name, s->workers, s->items.load(),
+                (double)s->busy_ns.load() / 1e9,
+                std::chrono::duration<double>(now - s->started).count(),
+                s->depth()});
+        }
+        return ret;
+    }
+};
+
+template <class In, class Out = In>
+class Pipeline
+{
+public:
+    explicit Pipeline(size_t capacity) : shared(std::make_unique<PipelineShared>())
+    {
+        shared->capacity = capacity;
+        input = std::make_shared<PipelineQueue<In>>(capacity);
+        output = input;
+        shared->add_closer([q = input]()
+                           { q->close(); });
+    }
+
+    Pipeline(const Pipeline &) = delete;
+    void operator=(const Pipeline &) = delete;
+    Pipeline(Pipeline &&) = default;
+
+    // Adds a stage of workers threads, each running f on items from
+    // the current end of the pipeline.  Note this is on an rvalue:
+    // it consumes this pipeline and returns the longer one.
+    template <class F>
+    auto stage(std::string name, size_t workers, F f,
+               PipelineOrder order = PipelineOrder::Unordered) &&
+        -> Pipeline<In, std::decay_t<std::invoke_result_t<F &, Out>>>
+    {
+        using Next = std::decay_t<std::invoke_result_t<F &, Out>>;
+        // Grab our end before moving: when Next is Out the move
+        // below is the ordinary move constructor, which takes it too.
+        auto from = output;
+        Pipeline<In, Next> ret(std::move(*this));
+        auto to = std::make_shared<PipelineQueue<Next>>(ret.shared->capacity);
+        ret.output = to;
+        ret.shared->add_closer([to]()
+                               { to->close(); });
+
+        auto stats = std::make_shared<PipelineStage>();
+        stats->name = name;
+        stats->workers = std::max(workers, (size_t)1);
+        stats->live = stats->workers;
+        stats->depth = [from]()
+        { return from->size(); };
+        ret.shared->add_stats(stats);
+
+        std::shared_ptr<PipelineReorder<Next>> reorder;
+        if (order == PipelineOrder::Ordered)
+        {
+            reorder = std::make_shared<PipelineReorder<Next>>(
+                std::max(ret.shared->capacity, (size_t)1), stats->workers);
+            ret.shared->add_closer([reorder]()
+                                   { reorder->close(); });
+        }
+
+        auto state = ret.shared.get();
+        for (size_t i = 0; i < stats->workers; ++i)
+        {
+            state->add_thread(std::jthread(
+                [state, from, to, stats, reorder, f]() mutable
+                {
+                    try
+                    {
+                        while (true)
+                        {
+                            auto item = from->get();
+                            if (state->stopping)
+                                break;
+                            if (reorder)
+                                reorder->admit(item.sequence);
+                            auto start = std::chrono::steady_clock::now();
+                            PipelineItem<Next> result{item.sequence, f(std::move(item.value))};
+                            stats->busy_ns += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                  std::chrono::steady_clock::now() - start)
+                                                  .count();
+                            stats->items++;
+                            if (reorder)
+                                reorder->emit(std::move(result), *to);
+                            else
+                                to->put(std::move(result));
+                        }
+                    }
+                    catch (WorkQueueClosedException &)
+                    {
+                        // End of stream (or shutdown).
+                    }
+                    catch (...)
+                    {
+                        state->fail(std::current_exception());
+                    }
+                    if (--stats->live == 0)
+                        to->close();
+                }));
+        }
+        return ret;
+    }
+
+    // Feeds an item in.  Blocks if the first stage is behind.
+    void put(In item)
+    {
+        auto sequence = shared->next_sequence++;
+        try
+        {
+            input->put(PipelineItem<In>{sequence, std::move(item)});
+        }
+        catch (WorkQueueClosedException &)
+        {
+            shared->rethrow_error();
+            throw;
+        }
+    }
+
+    // No more input.
+    void close() { input->close(); }
+
+    // The next result, or nothing once everything has come out the
+    // end.
+    std::optional<Out> next()
+    {
+        try
+        {
+            return output->get().value;
+        }
+        catch (WorkQueueClosedException &)
+        {
+            shared->rethrow_error();
+            return std::nullopt;
+        }
+    }
+
+    // Like next(), but throws WorkQueueClosedException at the end.
+    Out get()
+    {
+        auto ret = next();
+        if (!ret)
+            throw WorkQueueClosedException();
+        return std::move(*ret);
+    }
+
+    std::vector<PipelineStageStats> stats() const { return shared->snapshot(); }
+
+private:
+    template <class, class>
+    friend class Pipeline;
+
+    // For stage(): takes over the guts of a shorter pipeline.
+    template <class Before>
+    explicit Pipeline(Pipeline<In, Before> &&from)
+        : shared(std::move(from.shared)), input(std::move(from.input))
+    {
+    }
+
+    std::unique_ptr<PipelineShared> shared;
+    std::shared_ptr<PipelineQueue<In>> input;
+    std::shared_ptr<PipelineQueue<Out>> output;
+};
+
+#endif
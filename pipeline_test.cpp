@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <ranges>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <atomic>
+#include "pipeline.hpp"
+
+TEST(Pipeline, OrderedStages)
+{
+    auto p = Pipeline<int>(8)
+                 .stage("stringify", 4, [](int x)
+                        {
+                            // Make the workers finish out of order.
+                            std::this_thread::sleep_for(std::chrono::microseconds(std::rand() % 100));
+                            return std::to_string(x); })
+                 .stage("length", 3, [](std::string s)
+                        { return s + ":" + std::to_string(s.length()); },
+                        PipelineOrder::Ordered);
+    std::jthread feeder([&]()
+                        {
+                            for (auto i : std::views::iota(0, 1000))
+                            {
+                                p.put(i);
+                            }
+                            p.close(); });
+    int expected = 0;
+    while (auto x = p.next())
+    {
+        EXPECT_EQ(*x, std::to_string(expected) + ":" + std::to_string(std::to_string(expected).length()));
+        expected++;
+    }
+    EXPECT_EQ(expected, 1000);
+    EXPECT_THROW(p.get(), WorkQueueClosedException);
+
+    auto stats = p.stats();
+    ASSERT_EQ(stats.size(), 2);
+    EXPECT_EQ(stats[0].name, "stringify");
+    EXPECT_EQ(stats[0].workers, 4);
+    EXPECT_EQ(stats[0].items, 1000);
+    EXPECT_EQ(stats[1].items, 1000);
+    EXPECT_GT(stats[0].busy_seconds, 0);
+    EXPECT_GT(stats[1].items_per_second(), 0);
+}
+
+TEST(Pipeline, OrderedStageIsBounded)
+{
+    // Item 0 is slow.  The other workers may only get a window's worth
+    // ahead of it, not finish everything else while it's held up.
+    std::atomic<int> started = 0;
+    std::atomic<int> started_by_then = 0;
+    auto p = Pipeline<int>(4)
+                 .stage("slow first", 3, [&](int x)
+                        {
+                            started++;
+                            if (x == 0)
+                            {
+                                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                                started_by_then = started.load();
+                            }
+                            return x; },
+                        PipelineOrder::Ordered);
+    std::jthread feeder([&]()
+                        {
+                            for (auto i : std::views::iota(0, 1000))
+                            {
+                                p.put(i);
+                            }
+                            p.close(); });
+    int expected = 0;
+    while (auto x = p.next())
+        EXPECT_EQ(*x, expected++);
+    EXPECT_EQ(expected, 1000);
+    // The window, plus the items the blocked workers are holding.
+    EXPECT_LE(started_by_then.load(), 4 + 3);
+}
+
+TEST(Pipeline, UnorderedDeliversEverything)
+{
+    auto p = Pipeline<int>(4)
+                 .stage("double", 4, [](int x)
+                        { return x * 2L; });
+    std::jthread feeder([&]()
+                        {
+                            for (auto i : std::views::iota(0, 1000))
+                            {
+                                p.put(i);
+                            }
+                            p.close(); });
+    long total = 0;
+    int count = 0;
+    while (auto x = p.next())
+    {
+        total += *x;
+        count++;
+    }
+    EXPECT_EQ(count, 1000);
+    EXPECT_EQ(total, 999L * 1000);
+}
+
+TEST(Pipeline, NoStagesIsJustAQueue)
+{
+    Pipeline<std::string> p(2);
+    p.put("a");
+    p.put("b");
+    p.close();
+    EXPECT_EQ(p.get(), "a");
+    EXPECT_EQ(p.get(), "b");
+    EXPECT_FALSE(p.next());
+}
+
+TEST(Pipeline, StageExceptionShutsDown)
+{
+    auto p = Pipeline<int>(2)
+                 .stage("picky", 2, [](int x)
+                        {
+                            if (x == 10)
+                                throw std::domain_error("bad input");
+                            return x; })
+                 .stage("pass", 1, [](int x)
+                        { return x; });
+    std::jthread feeder([&]()
+                        {
+                            try
+                            {
+                                for (auto i : std::views::iota(0, 1000))
+                                {
+                                    p.put(i);
+                                }
+                            }
+                            catch (std::domain_error &)
+                            {
+                            } });
+    EXPECT_THROW(
+        while (p.next()) {},
+        std::domain_error);
+}
+
+TEST(Pipeline, DestroyWhileRunning)
+{
+    // Nobody drains the output, so every stage ends up blocked.
+    // Destroying the pipeline still has to get all the threads out.
+    auto p = Pipeline<int>(1)
+                 .stage("a", 2, [](int x)
+                        { return x; })
+                 .stage("b", 2, [](int x)
+                        { return x; });
+    for (auto i : std::views::iota(0, 3))
+    {
+        p.put(i);
+    }
+}
@@ -0,0 +1,141 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <memory>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+
+// A pool of same-sized objects, for data structures (lists, trees)
+// that allocate lots of little nodes.
+//
+// Getting every node from new costs a trip through the general purpose
+// allocator each time, and scatters the nodes around memory.  Instead
+// we carve them out of big slabs: a new object is the next unused slot
+// in the current slab, and a freed one goes on a free list (threaded
+// through the freed slots themselves), to be handed out again before
+// we touch fresh memory.  Nodes allocated one after another end up
+// next to each other, which is what a traversal wants.
+//
+// The slabs are only given back when the pool itself goes away.  The
+// pool doesn't know which slots are in use, so it doesn't run the
+// destructors of objects still live then: destroy() them first (or
+// don't bother, if T is trivially destructible).
+//
+// Not thread safe: one pool per container.
+template <class T>
+class ObjectPool
+{
+public:
+    // Slabs start at first_slab objects and double up to max_slab.
+    ObjectPool(size_t first_slab = 64, size_t max_slab = 65536)
+        : next_slab(std::max(first_slab, (size_t)1)), max_slab(std::max(max_slab, next_slab))
+    {
+    }
+
+    ObjectPool(const ObjectPool &) = delete;
+    void operator=(const ObjectPool &) = delete;
+
+    ObjectPool(ObjectPool &&other) noexcept { *this = std::move(other); }
+    ObjectPool &operator=(ObjectPool &&other) noexcept
+    {
+        slabs = std::move(other.slabs);
+        used_slabs = std::exchange(other.used_slabs, 0);
+        free_list = std::exchange(other.free_list, nullptr);
+        fresh = std::exchange(other.fresh, nullptr);
+        fresh_end = std::exchange(other.fresh_end, nullptr);
+        next_slab = other.next_slab;
+        max_slab = other.max_slab;
+        _live = std::exchange(other._live, 0);
+        return *this;
+    }
+
+    template <class... Args>
+    T *make(Args &&...args)
+    {
+        Slot *slot = take();
+        try
+        {
+            T *ret = new (slot->storage) T(std::forward<Args>(args)...);
+            _live++;
+            return ret;
+        }
+        catch (...)
+        {
+            give_back(slot);
+            throw;
+        }
+    }
+
+    void destroy(T *object)
+    {
+        object->~T();
+        give_back(reinterpret_cast<Slot *>(object));
+        _live--;
+    }
+
+    // How many objects are allocated right now.
+    size_t live() const { return _live; }
+
+    // Forgets every object at once, keeping the slabs to be filled
+    // again from the start.  Like the destructor, it doesn't run any
+    // destructors.
+    void reset()
+    {
+        free_list = nullptr;
+        fresh = fresh_end = nullptr;
+        used_slabs = 0;
+        _live = 0;
+    }
+
+private:
+    union Slot
+    {
+        Slot *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    struct Slab
+    {
+        std::unique_ptr<Slot[]> slots;
+        size_t size;
+    };
+
+    Slot *take()
+    {
+        if (free_list)
+            return std::exchange(free_list, free_list->next);
+        if (fresh == fresh_end)
+        {
+            // Slabs left over from before a reset() go first.
+            if (used_slabs == slabs.size())
+            {
+                slabs.push_back(Slab{std::make_unique_for_overwrite<Slot[]>(next_slab), next_slab});
+                next_slab = std::min(next_slab * 2, max_slab);
+            }
+            auto &slab = slabs[used_slabs++];
+            fresh = slab.slots.get();
+            fresh_end = fresh + slab.size;
+        }
+        return fresh++;
+    }
+
+    void give_back(Slot *slot)
+    {
+        slot->next = free_list;
+        free_list = slot;
+    }
+
+    std::vector<Slab> slabs;
+    size_t used_slabs = 0;
+    Slot *free_list = nullptr;
+    // The untouched part of the slab we are filling.
+    Slot *fresh = nullptr;
+    Slot *fresh_end = nullptr;
+    size_t next_slab;
+    size_t max_slab;
+    size_t _live = 0;
+};
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef POOLED_LLIST_HPP
+#define POOLED_LLIST_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include "llist.hpp"
+#include "pool.hpp"
+
+// The same list as LinkedList, stored differently.
+//
+// LinkedList gets every cell from make_shared and links them with
+// shared_ptrs.  That's the easy way to be safe, but every cell pays
+// for a control block and every link change for an atomic reference
+// count update.  Here the list owns its cells outright: they come out
+// of an ObjectPool that belongs to the list, and _next is a plain
+// pointer.  Building a list is mostly bumping a pointer through a
+// slab, and the cells end up next to each other in memory.
+//
+// Tearing down is a loop, not a recursion: destroying a LinkedList
+// used to destroy the head, whose destructor destroyed the next cell,
+// and so on, a stack frame per element.  For trivially destructible T
+// we don't even walk the list; dropping the pool's slabs is enough.
+//
+// Iterators are plain cell pointers (as LinkedList's are), so they
+// are only good while the list is.
+template <class T>
+class PooledLinkedList
+{
+    struct Cell
+    {
+        T _data;
+        Cell *_next;
+    };
+
+public:
+    template <bool Const>
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const, const T &, T &>;
+        using pointer = std::conditional_t<Const, const T *, T *>;
+
+        Iterator() {}
+        explicit Iterator(Cell *at) : _at(at) {}
+        // An iterator converts to a const one.
+        operator Iterator<true>() const { return Iterator<true>(_at); }
+
+        reference operator*() const { return _at->_data; }
+        pointer operator->() const { return &_at->_data; }
+        Iterator &operator++()
+        {
+            _at = _at->_next;
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            auto ret = *this;
+            _at = _at->_next;
+            return ret;
+        }
+        bool operator==(const Iterator &other) const { return _at == other._at; }
+
+    private:
+        Cell *_at = nullptr;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    PooledLinkedList() {}
+
+    // Assignment is a deep copy, like LinkedList's.
+    PooledLinkedList(const PooledLinkedList &other)
+    {
+        for (const auto &data : other)
+            append(data);
+    }
+
+    PooledLinkedList &operator=(const PooledLinkedList &other)
+    {
+        if (&other == this)
+            return *this;
+        clear();
+        for (const auto &data : other)
+            append(data);
+        return *this;
+    }
+
+    // Moving hands over the cells (and their pool) without copying.
+    PooledLinkedList(PooledLinkedList &&other) noexcept
+        : _pool(std::move(other._pool)),
+          _head(std::exchange(other._head, nullptr)),
+          _tail(std::exchange(other._tail, nullptr)),
+          _len(std::exchange(other._len, 0))
+    {
+    }
+
+    PooledLinkedList &operator=(PooledLinkedList &&other) noexcept
+    {
+        if (&other == this)
+            return *this;
+        clear();
+        _pool = std::move(other._pool);
+        _head = std::exchange(other._head, nullptr);
+        _tail = std::exchange(other._tail, nullptr);
+        _len = std::exchange(other._len, 0);
+        return *this;
+    }
+
+    ~PooledLinkedList() { clear(); }
+
+    size_t len() const { return _len; }
+
+    void prepend(const T &data)
+    {
+        _head = _pool.make(Cell{data, _head});
+        if (!_tail)
+            _tail = _head;
+        _len++;
+    }
+
+    void append(const T &data)
+    {
+        auto cell = _pool.make(Cell{data, nullptr});
+        if (!_head)
+            _head = cell;
+        else
+            _tail->_next = cell;
+        _tail = cell;
+        _len++;
+    }
+
+    T &operator[](size_t location)
+    {
+        for (auto at = _head; at; at = at->_next)
+        {
+            if (location == 0)
+                return at->_data;
+            location--;
+        }
+        throw SliceException("Index out of range");
+    }
+
+    // Destroys every element, one at a time in a loop.  The slabs are
+    // kept for the next elements.
+    void clear()
+    {
+        if constexpr (!std::is_trivially_destructible_v<T>)
+        {
+            auto at = _head;
+            while (at)
+            {
+                auto next = at->_next;
+                _pool.destroy(at);
+                at = next;
+            }
+        }
+        _pool.reset();
+        _head = _tail = nullptr;
+        _len = 0;
+    }
+
+    iterator begin() { return iterator(_head); }
+    iterator end() { return iterator(); }
+    const_iterator begin() const { return const_iterator(_head); }
+    const_iterator end() const { return const_iterator(); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+private:
+    ObjectPool<Cell> _pool;
+    Cell *_head = nullptr;
+    Cell *_tail = nullptr;
+    size_t _len = 0;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include "pooled_llist.hpp"
+
+TEST(ObjectPool, ReusesSlots)
+{
+    ObjectPool<std::string> pool(4, 16);
+    std::vector<std::string *> made;
+    for (auto i = 0; i < 10; ++i)
+        made.push_back(pool.make(std::to_string(i)));
+    EXPECT_EQ(pool.live(), 10u);
+    EXPECT_EQ(*made[7], "7");
+    // All different, and the first slab's are next to each other.
+    EXPECT_EQ(std::set<std::string *>(made.begin(), made.end()).size(), 10u);
+    EXPECT_EQ((char *)made[1] - (char *)made[0], (char *)made[2] - (char *)made[1]);
+
+    // A freed slot is the next one handed out.
+    auto freed = made[3];
+    pool.destroy(freed);
+    EXPECT_EQ(pool.live(), 9u);
+    EXPECT_EQ(pool.make("again"), freed);
+
+    for (auto p : made)
+        pool.destroy(p);
+    EXPECT_EQ(pool.live(), 0u);
+
+    // After a reset we start again from the first slab.
+    ObjectPool<int> ints(8);
+    auto first = ints.make(1);
+    ints.make(2);
+    ints.reset();
+    EXPECT_EQ(ints.make(3), first);
+}
+
+TEST(PooledLinkedList, SameAsLinkedList)
+{
+    PooledLinkedList<int> foo, bar;
+    EXPECT_EQ(foo.len(), 0u);
+    for (auto i = 0; i < 10; ++i)
+    {
+        EXPECT_THROW(foo[(size_t)i], SliceException);
+        foo.append(i);
+        bar.prepend(i);
+        EXPECT_EQ(foo[(size_t)i], i);
+        foo[(size_t)i] = 2 * i;
+    }
+    for (auto i = 0; i < 10; ++i)
+    {
+        EXPECT_EQ(bar[(size_t)i], 9 - i);
+        EXPECT_EQ(foo[(size_t)i], 2 * i);
+    }
+    for (auto &i : foo)
+        i /= 2;
+    auto j = 0;
+    for (auto i : std::as_const(foo))
+        EXPECT_EQ(i, j++);
+    EXPECT_EQ(std::count_if(foo.cbegin(), foo.cend(), [](int x)
+                            { return x > 4; }),
+              5);
+
+    // Copies are deep, moves hand the cells over.
+    auto copy = foo;
+    copy[0] = 100;
+    EXPECT_EQ(foo[0], 0);
+    auto moved = std::move(copy);
+    EXPECT_EQ(moved[0], 100);
+    EXPECT_EQ(copy.len(), 0u);
+    copy = moved;
+    EXPECT_EQ(copy.len(), 10u);
+
+    PooledLinkedList<std::string> words;
+    words.append("Hola");
+    words.prepend("Hello");
+    EXPECT_EQ(words[0], "Hello");
+    words.clear();
+    EXPECT_EQ(words.len(), 0u);
+    EXPECT_EQ(words.begin(), words.end());
+    words.append("again");
+    EXPECT_EQ(words[0], "again");
+}
+
+// Not really a test: building and destroying a big list each way.
+TEST(PooledLinkedList, DISABLED_Benchmark)
+{
+    const int n = 2000000;
+    auto time = [](auto f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    auto shared = std::make_unique<LinkedList<int>>();
+    auto pooled = std::make_unique<PooledLinkedList<int>>();
+    auto shared_build = time([&]()
+                             { for (auto i = 0; i < n; ++i) shared->append(i); });
+    auto pooled_build = time([&]()
+                             { for (auto i = 0; i < n; ++i) pooled->append(i); });
+    EXPECT_EQ(shared->len(), pooled->len());
+    auto shared_free = time([&]()
+                            { shared.reset(); });
+    auto pooled_free = time([&]()
+                            { pooled.reset(); });
+    std::cout << "LinkedList build " << shared_build << "s, free " << shared_free
+              << "s; PooledLinkedList build " << pooled_build << "s, free " << pooled_free << "s\n";
+}
@@ -0,0 +1,219 @@
+#ifndef PRIORITY_WORKQUEUE_HPP
+#define PRIORITY_WORKQUEUE_HPP
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include "queue_gate.hpp"
+
+// A blocking priority queue with the same capacity, back-pressure and
+// closing behavior as WorkQueue, except that get() returns the element
+// with the highest priority rather than the oldest one.
+//
+// A single heap behind a single lock serializes everybody.  So instead
+// this is a "MultiQueue" (Rihani, Sanders and Dementiev, 2015): the
+// elements are spread over several independently locked heaps
+// (shards).  put() pushes onto a random shard.  get() looks at two
+// random shards and pops from the one whose top is more urgent.  Each
+// shard keeps a copy of its top priority in an atomic so that
+// comparison doesn't need a lock.
+//
+// The price is that the ordering is relaxed: get() returns one of the
+// most urgent elements, not necessarily THE most urgent one.  With a
+// single shard the ordering is exact (and it is just a locked heap).
+// Elements of equal priority in the same shard come out in FIFO order.
+template <class T, class Priority = int>
+class PriorityWorkQueue
+{
+    // We need to be able to read it atomically.
+    static_assert(std::is_arithmetic_v<Priority>, "Priority must be a number");
+
+public:
+    // Capacity 0 is unlimited, like WorkQueue.  With shards == 0 we
+    // pick a number based on the number of cores: the MultiQueue paper
+    // suggests a small multiple of the number of threads.
+    PriorityWorkQueue(size_t capacity = 0, size_t shards = 0, WaitStrategy how = {})
+        : gate(capacity, how)
+    {
+        if (shards == 0)
+            shards = 2 * std::max(std::thread::hardware_concurrency(), 1u);
+        for (size_t i = 0; i < shards; ++i)
+            heaps.push_back(std::make_unique<Shard>());
+    }
+
+    PriorityWorkQueue(const PriorityWorkQueue &) = delete;
+    void operator=(const PriorityWorkQueue &) = delete;
+
+    // Blocks until there is room.  Throws WorkQueueClosedException if
+    // the queue is (or becomes) closed.
+    void put(const T &element, Priority priority)
+    {
+        if (!gate.reserve_slot(true, std::nullopt))
+            throw WorkQueueClosedException();
+        push(element, priority);
+    }
+
+    bool try_put(const T &element, Priority priority)
+    {
+        if (!gate.reserve_slot(false, std::nullopt))
+            return false;
+        push(element, priority);
+        return true;
+    }
+
+    template <class Rep, class Period>
+    bool put_for(const T &element, Priority priority,
+                 const std::chrono::duration<Rep, Period> &timeout)
+    {
+        if (!gate.reserve_slot(true, std::chrono::steady_clock::now() + timeout))
+            return false;
+        push(element, priority);
+        return true;
+    }
+
+    // Blocks until there is data.  Throws WorkQueueClosedException
+    // if the queue is closed and empty.
+    T get()
+    {
+        if (!gate.claim_item(true, std::nullopt))
+            throw WorkQueueClosedException();
+        return pop();
+    }
+
+    std::optional<T> try_get()
+    {
+        if (!gate.claim_item(false, std::nullopt))
+            return std::nullopt;
+        return pop();
+    }
+
+    template <class Rep, class Period>
+    std::optional<T> get_for(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        if (!gate.claim_item(true, std::chrono::steady_clock::now() + timeout))
+            return std::nullopt;
+        return pop();
+    }
+
+    void close() { gate.close(); }
+    bool is_closed() const { return gate.is_closed(); }
+    size_t size() const { return gate.size(); }
+    size_t shards() const { return heaps.size(); }
+
+private:
+    struct Entry
+    {
+        Priority priority;
+        uint64_t sequence;
+        T value;
+
+        // std::push_heap builds a max heap, so "less" means "less
+        // urgent": lower priority, or the same priority but newer.
+        bool operator<(const Entry &other) const
+        {
+            if (priority != other.priority)
+                return priority < other.priority;
+            return sequence > other.sequence;
+        }
+    };
+
+    // Each shard gets its own cache lines so that two threads
+    // working on neighboring shards don't fight over them.
+    struct alignas(64) Shard
+    {
+        std::mutex lock;
+        std::vector<Entry> heap;
+        uint64_t next_sequence = 0;
+        std::atomic<bool> empty = true;
+        std::atomic<Priority> top = 0;
+
+        // Must hold the lock.
+        void update_top()
+        {
+            empty.store(heap.empty(), std::memory_order_relaxed);
+            if (!heap.empty())
+                top.store(heap.front().priority, std::memory_order_relaxed);
+        }
+    };
+
+    static size_t next_random()
+    {
+        thread_local uint64_t state =
+            std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return (size_t)state;
+    }
+
+    void push(const T &element, Priority priority)
+    {
+        auto &shard = *heaps[next_random() % heaps.size()];
+        {
+            std::unique_lock l(shard.lock);
+            shard.heap.push_back(Entry{priority, shard.next_sequence++, element});
+            std::push_heap(shard.heap.begin(), shard.heap.end());
+            shard.update_top();
+        }
+        gate.publish();
+    }
+
+    // Is a a better choice than b, going by their cached tops?
+    static bool better(const Shard &a, const Shard &b)
+    {
+        if (a.empty.load(std::memory_order_relaxed))
+            return false;
+        if (b.empty.load(std::memory_order_relaxed))
+            return true;
+        return a.top.load(std::memory_order_relaxed) >= b.top.load(std::memory_order_relaxed);
+    }
+
+    // We have claimed an item, so there is at least one element that
+    // is ours somewhere.  The cached tops can be stale, so we might
+    // find a shard empty by the time we lock it, in which case we
+    // just try again.
+    T pop()
+    {
+        while (true)
+        {
+            auto n = heaps.size();
+            auto i = next_random() % n;
+            auto j = next_random() % n;
+            auto choice = better(*heaps[i], *heaps[j]) ? i : j;
+            if (heaps[choice]->empty.load(std::memory_order_relaxed))
+            {
+                // Both our picks were empty, so go looking.
+                for (size_t k = 1; k < n; ++k)
+                {
+                    auto next = (choice + k) % n;
+                    if (!heaps[next]->empty.load(std::memory_order_relaxed))
+                    {
+                        choice = next;
+                        break;
+                    }
+                }
+            }
+            auto &shard = *heaps[choice];
+            std::unique_lock l(shard.lock);
+            if (shard.heap.empty())
+                continue;
+            std::pop_heap(shard.heap.begin(), shard.heap.end());
+            T ret = std::move(shard.heap.back().value);
+            shard.heap.pop_back();
+            shard.update_top();
+            l.unlock();
+            gate.release_slot();
+            return ret;
+        }
+    }
+
+    QueueGate gate;
+    std::vector<std::unique_ptr<Shard>> heaps;
+};
+
+#endif
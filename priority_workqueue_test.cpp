@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+#include <ranges>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <set>
+#include "priority_workqueue.hpp"
+#include "workqueue.hpp"
+
+TEST(PriorityWorkQueue, SingleShardIsExact)
+{
+    PriorityWorkQueue<std::string> w(0, 1);
+    w.put("bulk 1", 1);
+    w.put("urgent", 10);
+    w.put("bulk 2", 1);
+    w.put("normal", 5);
+    EXPECT_EQ(w.get(), "urgent");
+    EXPECT_EQ(w.get(), "normal");
+    // Equal priorities come out oldest first.
+    EXPECT_EQ(w.get(), "bulk 1");
+    EXPECT_EQ(w.get(), "bulk 2");
+    EXPECT_FALSE(w.try_get());
+
+    // And a lot of them drain in order.
+    PriorityWorkQueue<int> many(0, 1);
+    std::mt19937 rng(42);
+    for (auto i : std::views::iota(0, 20000))
+    {
+        auto p = (int)(rng() % 1000);
+        many.put(p, p);
+        (void)i;
+    }
+    int last = 1000;
+    for (auto i : std::views::iota(0, 20000))
+    {
+        (void)i;
+        auto p = many.get();
+        EXPECT_LE(p, last);
+        last = p;
+    }
+}
+
+TEST(PriorityWorkQueue, CapacityAndClose)
+{
+    using namespace std::chrono_literals;
+    PriorityWorkQueue<int> w(2, 4);
+    EXPECT_TRUE(w.try_put(1, 1));
+    EXPECT_TRUE(w.try_put(2, 2));
+    EXPECT_FALSE(w.try_put(3, 3));
+    EXPECT_FALSE(w.put_for(3, 3, 10ms));
+    EXPECT_EQ(w.size(), 2);
+
+    // A blocked producer gets going again once there is room.
+    std::jthread j([&]()
+                   { w.put(3, 3); });
+    std::set<int> got;
+    for (auto i : std::views::iota(0, 3))
+    {
+        (void)i;
+        got.insert(w.get());
+    }
+    EXPECT_EQ(got, std::set<int>({1, 2, 3}));
+    EXPECT_FALSE(w.get_for(10ms));
+
+    w.put(4, 4);
+    w.close();
+    EXPECT_THROW(w.put(5, 5), WorkQueueClosedException);
+    EXPECT_EQ(w.get(), 4);
+    EXPECT_THROW(w.get(), WorkQueueClosedException);
+}
+
+TEST(PriorityWorkQueue, ManyProducersAndConsumers)
+{
+    const int producers = 4;
+    const int per_producer = 5000;
+    PriorityWorkQueue<int> w(64);
+    std::vector<std::atomic<int>> seen(producers * per_producer);
+    {
+        std::vector<std::jthread> threads;
+        for (auto p : std::views::iota(0, producers))
+        {
+            threads.emplace_back([&, p]()
+                                 {
+                                    for (auto i : std::views::iota(0, per_producer))
+                                    {
+                                        w.put(p * per_producer + i, i % 7);
+                                    } });
+            threads.emplace_back([&]()
+                                 {
+                                    for (auto i : std::views::iota(0, per_producer))
+                                    {
+                                        (void)i;
+                                        seen[w.get()]++;
+                                    } });
+        }
+    }
+    for (auto &s : seen)
+    {
+        EXPECT_EQ(s, 1);
+    }
+}
+
+// Not really a test: compares the sharded queue against a single
+// locked heap.  Throughput is many threads doing put/get pairs.  The
+// inversion rate is how often, draining a full queue, we got something
+// less urgent than the thing we got before it.
+TEST(PriorityWorkQueue, DISABLED_Benchmark)
+{
+    const int threads = 4;
+    const int ops = 20000;
+    const int drain = 20000;
+    for (size_t shards : {(size_t)1, (size_t)2 * threads})
+    {
+        PriorityWorkQueue<int> w(0, shards);
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::vector<std::jthread> workers;
+            for (auto t : std::views::iota(0, threads))
+            {
+                workers.emplace_back([&, t]()
+                                     {
+                                        for (auto i : std::views::iota(0, ops))
+                                        {
+                                            w.put(i, (i * 7 + t) % 100);
+                                            w.get();
+                                        } });
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::mt19937 rng(42);
+        for (auto i : std::views::iota(0, drain))
+        {
+            auto p = (int)(rng() % 1000);
+            w.put(p, p);
+            (void)i;
+        }
+        int inversions = 0;
+        int last = 1000;
+        for (auto i : std::views::iota(0, drain))
+        {
+            (void)i;
+            auto p = w.get();
+            if (p > last)
+                inversions++;
+            last = p;
+        }
+        std::cout << "shards " << shards << ": "
+                  << (threads * ops * 2) / elapsed.count() << " ops/sec, "
+                  << 100.0 * inversions / drain << "% inversions\n";
+    }
+}
@@ -0,0 +1,225 @@
+#ifndef QUEUE_GATE_HPP
+#define QUEUE_GATE_HPP
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <optional>
+#include <thread>
+#include "workqueue.hpp"
+
+// The counting half of a blocking queue, for queues that split their
+// storage over several independently locked pieces (shards, lanes).
+//
+// WorkQueue can check "is there room" and "is there data" while it
+// holds its one lock.  Once the data is spread out there is no single
+// lock to hold, so instead the gate keeps two atomic counters:
+//
+//   slots: how many elements are in the queue or about to be, which
+//          is what the capacity limits.
+//   items: how many elements are stored and not yet claimed by a
+//          consumer.
+//
+// A producer reserve_slot()s, stores its element wherever it likes and
+// then publish()es it.  A consumer claim_item()s, which guarantees
+// that there is an element somewhere for it, goes and finds one, and
+// then release_slot()s.  Only the blocking is done with a lock and
+// condition variables, and nobody touches those unless somebody
+// actually has to sleep.  With no capacity there is nothing to count
+// slots against, so they aren't counted at all.
+//
+// Queues that keep their own counts (per lane, say), so that
+// producers never touch a shared counter, can use just the blocking:
+// wait_for_room() and wait_for_data() sleep until their attempt
+// succeeds, and the other side calls room_freed() and data_added().
+class QueueGate
+{
+public:
+    using Deadline = std::optional<std::chrono::steady_clock::time_point>;
+
+    QueueGate(size_t size = 0, WaitStrategy how = {}) : capacity(size), strategy(how) {}
+
+    QueueGate(const QueueGate &) = delete;
+    void operator=(const QueueGate &) = delete;
+
+    // Returns false if the queue is closed, or it would have to
+    // wait and block is false, or the deadline passed.
+    bool reserve_slot(bool block, const Deadline &deadline)
+    {
+        return wait_for([this]()
+                        { return try_reserve(); },
+                        [this]()
+                        { return capacity == 0 || slots.load(std::memory_order_relaxed) < capacity; },
+                        put_waiters, notify_put, block, deadline);
+    }
+
+    // Gives back a slot that was reserved but never published.
+    void cancel_slot() { release_slot(); }
+
+    void publish()
+    {
+        items.fetch_add(1);
+        data_added();
+    }
+
+    // Returns false if the queue is closed and empty, or it would
+    // have to wait and block is false, or the deadline passed.
+    bool claim_item(bool block, const Deadline &deadline)
+    {
+        return wait_for([this]()
+                        { return try_claim(); },
+                        [this]()
+                        { return items.load(std::memory_order_relaxed) > 0; },
+                        get_waiters, notify_get, block, deadline);
+    }
+
+    void release_slot()
+    {
+        if (capacity == 0)
+            return;
+        slots.fetch_sub(1);
+        room_freed();
+    }
+
+    // attempt() tries to take room (or an element) and says whether it
+    // did.  Returns false if attempt() failed and the queue is closed,
+    // or it would have to wait and block is false, or the deadline
+    // passed.
+    template <class Attempt>
+    bool wait_for_room(Attempt attempt, bool block, const Deadline &deadline)
+    {
+        return wait_for(attempt, []()
+                        { return true; },
+                        put_waiters, notify_put, block, deadline);
+    }
+
+    template <class Attempt>
+    bool wait_for_data(Attempt attempt, bool block, const Deadline &deadline)
+    {
+        return wait_for(attempt, []()
+                        { return true; },
+                        get_waiters, notify_get, block, deadline);
+    }
+
+    // Call these after the change an attempt() will see, which has to
+    // be sequentially consistent (see wait_for()).
+    void room_freed()
+    {
+        if (put_waiters.load() > 0)
+        {
+            {
+                std::unique_lock l(lock);
+            }
+            notify_put.notify_one();
+        }
+    }
+
+    void data_added()
+    {
+        if (get_waiters.load() > 0)
+        {
+            {
+                std::unique_lock l(lock);
+            }
+            notify_get.notify_one();
+        }
+    }
+
+    void close()
+    {
+        {
+            std::unique_lock l(lock);
+            closed = true;
+        }
+        notify_get.notify_all();
+        notify_put.notify_all();
+    }
+
+    bool is_closed() const { return closed; }
+
+    size_t size() const { return items.load(std::memory_order_relaxed); }
+
+private:
+    bool try_reserve()
+    {
+        if (closed)
+            return false;
+        if (capacity == 0)
+            return true;
+        auto now = slots.load();
+        do
+        {
+            if (now >= capacity)
+                return false;
+        } while (!slots.compare_exchange_weak(now, now + 1));
+        return true;
+    }
+
+    bool try_claim()
+    {
+        auto now = items.load();
+        do
+        {
+            if (now == 0)
+                return false;
+        } while (!items.compare_exchange_weak(now, now - 1));
+        return true;
+    }
+
+    // The waiter bumps its waiter count and then looks at the counter;
+    // the other side bumps the counter and then looks at the waiter
+    // count.  As all four are sequentially consistent at least one of
+    // them sees the other, so a wakeup can't get lost.
+    template <class Attempt, class Hint>
+    bool wait_for(Attempt attempt, Hint hint, std::atomic<size_t> &waiters,
+                  std::condition_variable &cv, bool block, const Deadline &deadline)
+    {
+        if (attempt())
+            return true;
+        if (!block || closed)
+            return false;
+        for (size_t i = 0; i < strategy.spins + strategy.yields; ++i)
+        {
+            if (closed)
+                return false;
+            if (hint() && attempt())
+                return true;
+            if (i < strategy.spins)
+                workqueue_cpu_relax();
+            else
+                std::this_thread::yield();
+        }
+        std::unique_lock l(lock);
+        waiters++;
+        bool timed_out = false;
+        bool ret = false;
+        while (!(ret = attempt()))
+        {
+            if (closed || timed_out)
+                break;
+            if (deadline)
+                timed_out = cv.wait_until(l, *deadline) == std::cv_status::timeout;
+            else
+                cv.wait(l);
+        }
+        waiters--;
+        return ret;
+    }
+
+    const size_t capacity;
+    const WaitStrategy strategy;
+    // Producers and consumers both write these two, so each gets its
+    // own cache line, and the rarely written state below another.
+    alignas(64) std::atomic<size_t> slots = 0;
+    alignas(64) std::atomic<size_t> items = 0;
+    alignas(64) std::atomic<bool> closed = false;
+
+    std::mutex lock;
+    std::condition_variable notify_get;
+    std::condition_variable notify_put;
+    std::atomic<size_t> get_waiters = 0;
+    std::atomic<size_t> put_waiters = 0;
+};
+
+#endif
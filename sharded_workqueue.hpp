@@ -0,0 +1,276 @@
+#ifndef SHARDED_WORKQUEUE_HPP
+#define SHARDED_WORKQUEUE_HPP
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <algorithm>
+#include "queue_gate.hpp"
+
+// A WorkQueue for fan-in: lots of producers, few consumers.
+//
+// With one lock every producer waits for every other producer.  Here
+// the queue is split into lanes, each a deque with its own lock, and
+// each producer thread always puts into the same lane.  So producers
+// only collide when they share a lane, and with at least as many lanes
+// as producers that doesn't happen at all.  Consumers go around the
+// lanes round-robin.
+//
+// Nor is there a queue-wide count for producers to fight over: each
+// lane counts its own elements, and the capacity is handed out to the
+// lanes as credit, one unit per element.  A put spends a unit of its
+// own lane's credit (or, when that has run out, takes one from
+// another lane), and a get gives it back to the lane it took the
+// element from.  So the credit ends up with the lanes that are busy,
+// a producer keeps to its own lane's cache lines, and the queue still
+// never holds more than the capacity.  Only sleeping and waking up go
+// through a shared QueueGate.
+//
+// The capacity limit, blocking, back-pressure and close() behave like
+// WorkQueue's, and since a producer always uses the same lane, the
+// elements from any one producer come out in the order it put them.
+// There is no ordering between different producers.
+template <class T>
+class ShardedWorkQueue
+{
+public:
+    // Capacity 0 is unlimited, like WorkQueue.  With lanes == 0 we
+    // use one per core.
+    ShardedWorkQueue(size_t capacity = 0, size_t lanes = 0, WaitStrategy how = {})
+        : bounded(capacity != 0), gate(0, how)
+    {
+        if (lanes == 0)
+            lanes = std::max(std::thread::hardware_concurrency(), 1u);
+        for (size_t i = 0; i < lanes; ++i)
+        {
+            shards.push_back(std::make_unique<Lane>());
+            shards.back()->credit = capacity / lanes + (i < capacity % lanes);
+        }
+    }
+
+    ShardedWorkQueue(const ShardedWorkQueue &) = delete;
+    void operator=(const ShardedWorkQueue &) = delete;
+
+    // Blocks until there is room.  Throws WorkQueueClosedException if
+    // the queue is (or becomes) closed.
+    void put(const T &element)
+    {
+        if (!push(element, true, std::nullopt))
+            throw WorkQueueClosedException();
+    }
+
+    bool try_put(const T &element) { return push(element, false, std::nullopt); }
+
+    template <class Rep, class Period>
+    bool put_for(const T &element, const std::chrono::duration<Rep, Period> &timeout)
+    {
+        return push(element, true, std::chrono::steady_clock::now() + timeout);
+    }
+
+    // Blocks until there is data.  Throws WorkQueueClosedException
+    // if the queue is closed and empty.
+    T get()
+    {
+        auto ret = pop(true, std::nullopt);
+        if (!ret)
+            throw WorkQueueClosedException();
+        return std::move(*ret);
+    }
+
+    std::optional<T> try_get() { return pop(false, std::nullopt); }
+
+    template <class Rep, class Period>
+    std::optional<T> get_for(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        return pop(true, std::chrono::steady_clock::now() + timeout);
+    }
+
+    void close() { gate.close(); }
+    bool is_closed() const { return gate.is_closed(); }
+
+    size_t size() const
+    {
+        size_t ret = 0;
+        for (auto &lane : shards)
+            ret += lane->count.load(std::memory_order_relaxed);
+        return ret;
+    }
+
+    size_t lanes() const { return shards.size(); }
+
+private:
+    using Deadline = QueueGate::Deadline;
+
+    // Each lane gets its own cache lines so that producers on
+    // neighboring lanes don't fight over them.
+    struct alignas(64) Lane
+    {
+        std::mutex lock;
+        std::deque<T> data;
+        // How many elements data has, so consumers can skip empty
+        // lanes without locking them.
+        std::atomic<size_t> count = 0;
+        // How many more elements the queue has room for, of the ones
+        // this lane looks after.
+        std::atomic<size_t> credit = 0;
+    };
+
+    // Threads are numbered the first time they use any
+    // ShardedWorkQueue, and thread n always uses lane n % lanes.
+    // Numbering them in order (rather than hashing the thread id)
+    // spreads a set of producers evenly over the lanes.
+    static size_t thread_number()
+    {
+        static std::atomic<size_t> next = 0;
+        thread_local size_t mine = next++;
+        return mine;
+    }
+
+    static bool take_credit(Lane &lane)
+    {
+        auto now = lane.credit.load();
+        do
+        {
+            if (now == 0)
+                return false;
+        } while (!lane.credit.compare_exchange_weak(now, now - 1));
+        return true;
+    }
+
+    // Our own lane's credit first, and only if that has run out do we
+    // go looking in the others.
+    bool reserve(size_t mine)
+    {
+        if (gate.is_closed())
+            return false;
+        auto n = shards.size();
+        for (size_t k = 0; k < n; ++k)
+        {
+            if (take_credit(*shards[(mine + k) % n]))
+                return true;
+        }
+        return false;
+    }
+
+    void give_back(Lane &lane)
+    {
+        lane.credit.fetch_add(1);
+        gate.room_freed();
+    }
+
+    bool push(const T &element, bool block, const Deadline &deadline)
+    {
+        auto mine = thread_number() % shards.size();
+        if (bounded && !gate.wait_for_room([&]()
+                                           { return reserve(mine); },
+                                           block, deadline))
+            return false;
+        auto &lane = *shards[mine];
+        {
+            std::unique_lock l(lane.lock);
+            // Checked under the lane's lock, so that once a consumer
+            // has seen the queue closed and then been through every
+            // lane's lock, nothing more can turn up.
+            if (gate.is_closed())
+            {
+                l.unlock();
+                if (bounded)
+                    give_back(lane);
+                return false;
+            }
+            lane.data.push_back(element);
+            // Sequentially consistent, for data_added() (see
+            // QueueGate::wait_for()).
+            lane.count.store(lane.data.size());
+        }
+        gate.data_added();
+        return true;
+    }
+
+    static void take_front(Lane &lane, std::optional<T> &ret)
+    {
+        ret.emplace(std::move(lane.data.front()));
+        lane.data.pop_front();
+        // Nobody waits for a lane to empty, so this needn't be ordered.
+        lane.count.store(lane.data.size(), std::memory_order_relaxed);
+    }
+
+    // We start where this thread left off last time.  On the first
+    // time round we only try_lock, so a consumer moves on rather than
+    // queue up behind a producer busy with that lane; the second time
+    // round we wait for the lock, since an element in a lane we
+    // skipped won't wake us up again.  This runs under the gate's
+    // lock, so giving the credit back is left to our caller.
+    bool try_pop(std::optional<T> &ret, Lane *&from)
+    {
+        thread_local size_t cursor = 0;
+        auto n = shards.size();
+        // (The cursor is shared by every queue the thread uses.)
+        auto start = cursor < n ? cursor : 0;
+        for (size_t round = 0; round < 2; ++round)
+        {
+            auto i = start;
+            for (size_t k = 0; k < n; ++k, i = i + 1 == n ? 0 : i + 1)
+            {
+                auto &lane = *shards[i];
+                if (lane.count.load() == 0)
+                    continue;
+                std::unique_lock l(lane.lock, std::defer_lock);
+                if (round == 0)
+                {
+                    if (!l.try_lock())
+                        continue;
+                }
+                else
+                {
+                    l.lock();
+                }
+                if (lane.data.empty())
+                    continue;
+                cursor = i + 1;
+                take_front(lane, ret);
+                from = &lane;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::optional<T> pop(bool block, const Deadline &deadline)
+    {
+        std::optional<T> ret;
+        Lane *from = nullptr;
+        if (!gate.wait_for_data([&]()
+                                { return try_pop(ret, from); },
+                                block, deadline) &&
+            gate.is_closed())
+        {
+            // A put that got into its lane just before the close may
+            // not have counted its element yet, so the last look goes
+            // through every lane's lock.
+            for (auto &lane : shards)
+            {
+                std::unique_lock l(lane->lock);
+                if (!lane->data.empty())
+                {
+                    take_front(*lane, ret);
+                    from = lane.get();
+                    break;
+                }
+            }
+        }
+        if (from && bounded)
+            give_back(*from);
+        return ret;
+    }
+
+    const bool bounded;
+    QueueGate gate;
+    std::vector<std::unique_ptr<Lane>> shards;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <ranges>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include "sharded_workqueue.hpp"
+#include "workqueue.hpp"
+
+TEST(ShardedWorkQueue, PerProducerFifo)
+{
+    const int producers = 8;
+    const int per_producer = 2000;
+    ShardedWorkQueue<std::pair<int, int>> w(32, 4);
+    std::vector<std::jthread> threads;
+    for (auto p : std::views::iota(0, producers))
+    {
+        threads.emplace_back([&, p]()
+                             {
+                                for (auto i : std::views::iota(0, per_producer))
+                                {
+                                    w.put({p, i});
+                                } });
+    }
+    std::vector<int> next(producers, 0);
+    for (auto i : std::views::iota(0, producers * per_producer))
+    {
+        (void)i;
+        auto [p, x] = w.get();
+        EXPECT_EQ(x, next[p]);
+        next[p]++;
+    }
+    for (auto n : next)
+    {
+        EXPECT_EQ(n, per_producer);
+    }
+    EXPECT_FALSE(w.try_get());
+}
+
+TEST(ShardedWorkQueue, CapacityAndClose)
+{
+    using namespace std::chrono_literals;
+    ShardedWorkQueue<int> w(2, 4);
+    EXPECT_TRUE(w.try_put(1));
+    EXPECT_TRUE(w.try_put(2));
+    EXPECT_FALSE(w.try_put(3));
+    EXPECT_FALSE(w.put_for(3, 10ms));
+    EXPECT_EQ(w.get(), 1);
+    EXPECT_TRUE(w.put_for(3, 10ms));
+    w.close();
+    EXPECT_THROW(w.put(4), WorkQueueClosedException);
+    EXPECT_EQ(w.get(), 2);
+    EXPECT_EQ(w.get_for(10ms), 3);
+    EXPECT_THROW(w.get(), WorkQueueClosedException);
+}
+
+TEST(ShardedWorkQueue, CreditMovesBetweenLanes)
+{
+    // Less capacity than lanes, so most lanes start with no credit,
+    // and one producer still gets to fill the whole queue.
+    ShardedWorkQueue<int> w(3, 8);
+    EXPECT_TRUE(w.try_put(1));
+    EXPECT_TRUE(w.try_put(2));
+    EXPECT_TRUE(w.try_put(3));
+    EXPECT_FALSE(w.try_put(4));
+    EXPECT_EQ(w.size(), 3u);
+    // Whichever lane the credit comes back to, it's everybody's.
+    std::jthread other([&]()
+                       {
+                           EXPECT_EQ(w.get(), 1);
+                           EXPECT_TRUE(w.try_put(4));
+                           EXPECT_FALSE(w.try_put(5)); });
+    other.join();
+    // The other thread's 4 is in another lane, so it can come out
+    // before our 2 and 3.
+    std::vector<int> rest{w.get(), w.get(), w.get()};
+    std::ranges::sort(rest);
+    EXPECT_EQ(rest, (std::vector<int>{2, 3, 4}));
+    EXPECT_EQ(w.size(), 0u);
+}
+
+TEST(ShardedWorkQueue, ElementsPutBeforeCloseAreAllThere)
+{
+    // Producers racing with close(): everything whose put didn't throw
+    // comes out, and then get() throws.
+    for (auto round : std::views::iota(0, 20))
+    {
+        (void)round;
+        ShardedWorkQueue<int> w(0, 4);
+        std::atomic<int> accepted = 0;
+        {
+            std::vector<std::jthread> threads;
+            for (auto p : std::views::iota(0, 4))
+            {
+                (void)p;
+                threads.emplace_back([&]()
+                                     {
+                                        try
+                                        {
+                                            for (;;)
+                                            {
+                                                w.put(1);
+                                                accepted++;
+                                            }
+                                        }
+                                        catch (WorkQueueClosedException &)
+                                        {
+                                        } });
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            w.close();
+        }
+        int got = 0;
+        try
+        {
+            for (;;)
+                got += w.get();
+        }
+        catch (WorkQueueClosedException &)
+        {
+        }
+        EXPECT_EQ(got, accepted);
+    }
+}
+
+// Not really a test: many producers feeding one consumer, through
+// a plain WorkQueue and through a ShardedWorkQueue.  Each producer
+// does a little work for every element it puts, as a real one would,
+// so with a core for each of them the sharded queue's rate goes up
+// with the number of producers, while the plain one's stops at what
+// its one lock can take.
+template <class Queue>
+double fan_in(Queue &w, int producers, int per_producer)
+{
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::vector<std::jthread> threads;
+        for (auto p : std::views::iota(0, producers))
+        {
+            threads.emplace_back([&, p]()
+                                 {
+                                    unsigned x = (unsigned)p;
+                                    for (auto i : std::views::iota(0, per_producer))
+                                    {
+                                        for (auto k = 0; k < 100; ++k)
+                                            x = x * 1103515245 + 12345;
+                                        w.put(i + (int)(x & 1));
+                                    } });
+        }
+        for (auto i : std::views::iota(0, producers * per_producer))
+        {
+            (void)i;
+            w.get();
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return producers * per_producer / elapsed.count();
+}
+
+TEST(ShardedWorkQueue, DISABLED_Benchmark)
+{
+    for (auto producers : {1, 2, 4, 8, 16})
+    {
+        WorkQueue<int> plain(1024);
+        ShardedWorkQueue<int> sharded(1024, producers);
+        auto a = fan_in(plain, producers, 20000);
+        auto b = fan_in(sharded, producers, 20000);
+        std::cout << producers << " producers: WorkQueue " << a
+                  << " puts/sec, ShardedWorkQueue " << b << " puts/sec\n";
+    }
+}
@@ -3,6 +3,16 @@
 
 #include <vector>
 #include <memory>
+#include <string>
+#include <span>
+#include <set>
+#include <utility>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
 
 class SliceException : public std::exception
 {
@@ -20,71 +30,544 @@ public:
     SliceOutOfBoundsException(const std::string &in) : SliceException(in) {};
 };
 
+// How slices cut from the same storage see each other's writes.
+//
+// Aliased (the default) is like having pointers into one array: a
+// write through one slice shows up in every slice that overlaps it,
+// and that includes push_back overwriting whatever comes after the
+// slice.
+//
+// CopyOnWrite makes slices behave like independent values.  They
+// still share the storage, so cutting a sub-slice stays O(1), but
+// before a slice writes to an element that some other slice can
+// see, it first moves to a private copy of its own elements.  Writes
+// nobody else can see still happen in place.  The mode belongs to the
+// storage, so every slice cut from a CopyOnWrite slice is one too.
+enum class SliceSharing
+{
+    Aliased,
+    CopyOnWrite
+};
+
+// How the storage grows when push_back, append or resize run out of
+// room.  The new capacity is the old one times factor, but at least
+// minimum, and of course at least what is needed right now.  Growing
+// geometrically (factor > 1) is what makes a long run of push_backs
+// O(1) each on average; a bigger factor means fewer reallocations but
+// more memory sitting unused.  If you know how big it will get, call
+// reserve() and there are no reallocations at all.
+struct SliceGrowth
+{
+    double factor = 2.0;
+    size_t minimum = 0;
+
+    size_t next(size_t capacity, size_t needed) const
+    {
+        auto grown = (size_t)((double)capacity * factor);
+        return std::max({grown, minimum, needed});
+    }
+};
+
+// Where a Slice's elements actually live.  Normally it is a vector
+// that all the slices cut from it share.  But it can also be somebody
+// else's memory that we are only borrowing, in which case it can't
+// grow (and the owner has to keep it alive while we use it, unless
+// it gave us a keepalive to hold on to, as MappedSlice does).
+template <class T>
+struct SliceStorage
+{
+    std::vector<T> owned;
+    T *borrowed = nullptr;
+    size_t borrowed_size = 0;
+    bool is_borrowed = false;
+    std::shared_ptr<void> keepalive;
+    SliceGrowth growth;
+
+    SliceStorage() {}
+    SliceStorage(std::vector<T> &&from) : owned(std::move(from)) {}
+    SliceStorage(T *data, size_t size) : borrowed(data), borrowed_size(size), is_borrowed(true) {}
+
+    // For copy on write, the (start, length) of every slice using
+    // this storage.
+    bool copy_on_write = false;
+    std::multiset<std::pair<size_t, size_t>> views;
+    // Goes up every time a view is added.  Views going away can only
+    // make a slice's elements more private, so a slice that found it
+    // had its range to itself can rely on that until this changes.
+    uint64_t generation = 0;
+
+    T *base() { return is_borrowed ? borrowed : owned.data(); }
+    size_t size() const { return is_borrowed ? borrowed_size : owned.size(); }
+
+    // How many slices can see some of [start, end)?
+    size_t overlapping(size_t start, size_t end) const
+    {
+        size_t ret = 0;
+        for (auto &[s, len] : views)
+        {
+            if (s >= end)
+                break;
+            if (len > 0 && s + len > start)
+                ret++;
+        }
+        return ret;
+    }
+};
+
 template <class T>
 class Slice
 {
 public:
     Slice()
     {
-        _data = std::make_shared<std::vector<T>>();
+        _data = std::make_shared<SliceStorage<T>>();
         _start = 0;
         _len = 0;
     }
 
+    Slice(SliceSharing how) : Slice()
+    {
+        _data->copy_on_write = how == SliceSharing::CopyOnWrite;
+        attach();
+    }
+
     // Subrange
     Slice(Slice &s, int start, int end)
     {
         _data = s._data;
-        auto tmp = ((int)(s._start) + start);
-        if (tmp < 0)
-            throw SliceException("Negative Start");
-        if (end < start)
-            throw SliceException("End before start");
-        _start = (size_t)tmp;
-        _len = (size_t)end - start + 1;
-        if (_len > _data->size())
-            throw SliceException("Can't have slice beyond end");
+        set_range((int)(s._start) + start, start, end);
+        attach();
     }
 
-    Slice(std::vector<T> &from, int start, int end) {
-        _data = std::make_shared<std::vector<T>>(from);
-        auto tmp = (start);
-        if (tmp < 0)
-            throw SliceException("Negative Start");
-        if (end < start)
-            throw SliceException("End before start");
-        _start = (size_t)tmp;
+    // Copies share the storage, just like sub-slices do.
+    Slice(const Slice &other) : _data(other._data), _start(other._start), _len(other._len)
+    {
+        attach();
+    }
+
+    Slice &operator=(const Slice &other)
+    {
+        if (&other == this)
+            return *this;
+        detach();
+        _data = other._data;
+        _start = other._start;
+        _len = other._len;
+        attach();
+        return *this;
+    }
+
+    ~Slice() { detach(); }
+
+    // This copies, but only the part we are slicing out, so a small
+    // slice of a big vector is still cheap.  end has to be inside from
+    // (this used to check only the slice's length, which let a slice
+    // run off the end of the vector).
+    Slice(std::vector<T> &from, int start, int end)
+    {
+        check_range(start, end, from.size());
+        _data = std::make_shared<SliceStorage<T>>(
+            std::vector<T>(from.begin() + start, from.begin() + end + 1));
+        _start = 0;
         _len = (size_t)end - start + 1;
-        if (_len > _data->size())
-            throw SliceException("Can't have slice beyond end");
     }
 
+    // These take over the vector rather than copying it, so they are
+    // O(1) and don't allocate (beyond the shared bookkeeping).  Use
+    // std::move(v) to call them: v is left empty.
+    Slice(std::vector<T> &&from)
+    {
+        _len = from.size();
+        _start = 0;
+        _data = std::make_shared<SliceStorage<T>>(std::move(from));
+    }
+
+    Slice(std::vector<T> &&from, SliceSharing how) : Slice(std::move(from))
+    {
+        _data->copy_on_write = how == SliceSharing::CopyOnWrite;
+        attach();
+    }
+
+    Slice(std::vector<T> &&from, int start, int end)
+    {
+        check_range(start, end, from.size());
+        _data = std::make_shared<SliceStorage<T>>(std::move(from));
+        set_range(start, start, end);
+    }
+
+    // A slice over memory we don't own.  Nothing is copied, so
+    // writes go straight to the original, and it must outlive the
+    // slice (and every slice cut from it).  A borrowed slice can't
+    // grow past the end of what it borrowed.
+    static Slice borrow(T *data, size_t len)
+    {
+        return Slice(std::make_shared<SliceStorage<T>>(data, len), 0, len);
+    }
+
+    // As above, but the slices hold on to owner, which keeps the
+    // memory alive for as long as any of them are around.
+    static Slice borrow(T *data, size_t len, std::shared_ptr<void> owner)
+    {
+        auto storage = std::make_shared<SliceStorage<T>>(data, len);
+        storage->keepalive = std::move(owner);
+        return Slice(storage, 0, len);
+    }
+
+    static Slice borrow(std::vector<T> &from, int start, int end)
+    {
+        check_range(start, end, from.size());
+        return Slice(std::make_shared<SliceStorage<T>>(from.data(), from.size()),
+                     (size_t)start, (size_t)end - start + 1);
+    }
+
+    bool is_borrowed() const { return _data->is_borrowed; }
+    bool is_copy_on_write() const { return _data->copy_on_write; }
+
+    // Like for a sub-slice, "after the end" may be somebody else's
+    // element, in which case (when aliased) it gets overwritten rather
+    // than inserted.  Only at the end of the storage does it grow.
     void push_back(const T &value)
     {
+        prepare_write(_len, _len + 1);
         if (_start + _len >= _data->size())
         {
-            _data->push_back(value);
-            _len += 1;
+            check_growable();
+            auto &owned = _data->owned;
+            if (owned.size() == owned.capacity())
+            {
+                // value might be one of our own elements, which
+                // growing would move out from under us.
+                T copy(value);
+                grow(1);
+                owned.push_back(std::move(copy));
+            }
+            else
+            {
+                owned.push_back(value);
+            }
         }
         else {
-            _len += 1;
-            (*this)[_len-1] = value;
+            _data->base()[_start + _len] = value;
+        }
+        detach();
+        _len += 1;
+        attach();
+    }
+
+    // Adds everything in range to the end, in one go: the storage
+    // grows (at most) once, and for trivially copyable T coming from
+    // contiguous memory (a vector, array, span, another Slice...) the
+    // copying is a memcpy.  Any other input range works too, just
+    // more slowly.
+    template <std::ranges::input_range R>
+    void append(R &&range)
+    {
+        using Item = std::ranges::range_value_t<R>;
+        if constexpr (std::ranges::contiguous_range<R> && std::ranges::sized_range<R> &&
+                      std::is_same_v<Item, T>)
+        {
+            const T *from = std::ranges::data(range);
+            auto n = std::ranges::size(range);
+            if (n == 0)
+                return;
+            // Appending (part of) ourselves: growing could move the
+            // source, so copy it out first.
+            auto base = _data->base();
+            if (from < base + _data->size() && base < from + n)
+            {
+                std::vector<T> copy(from, from + n);
+                append_items(copy.data(), n);
+            }
+            else
+            {
+                append_items(from, n);
+            }
+        }
+        else if constexpr (std::ranges::forward_range<R>)
+        {
+            auto n = (size_t)std::ranges::distance(range);
+            if (n > 0)
+                append_items(std::ranges::begin(range), n);
+        }
+        else
+        {
+            for (auto &&x : range)
+                push_back(x);
+        }
+    }
+
+    // Makes sure we can grow to n elements without reallocating.
+    void reserve(size_t n)
+    {
+        if (n <= capacity())
+            return;
+        check_growable();
+        _data->owned.reserve(_start + n);
+    }
+
+    // How big we can get before the storage reallocates.
+    size_t capacity() const
+    {
+        if (_data->is_borrowed)
+            return _data->borrowed_size - _start;
+        return _data->owned.capacity() - _start;
+    }
+
+    // Shrinking just makes this slice shorter; the elements stay in the
+    // storage, for any other slices using them.  Growing adds copies
+    // of value, the same way append does.
+    void resize(size_t n, const T &value = T())
+    {
+        if (n <= _len)
+        {
+            detach();
+            _len = n;
+            attach();
+            return;
+        }
+        auto extra = n - _len;
+        T fill(value);
+        prepare_write(_len, n);
+        check_room(extra);
+        auto end = _start + _len;
+        auto over = std::min(room_after(end), extra);
+        std::fill_n(_data->base() + end, over, fill);
+        if (extra > over)
+        {
+            grow(extra - over);
+            _data->owned.insert(_data->owned.end(), extra - over, fill);
         }
+        detach();
+        _len = n;
+        attach();
     }
 
+    // The growth policy belongs to the storage, so it is shared with
+    // every slice cut from this one.
+    void set_growth(SliceGrowth how) { _data->growth = how; }
+    SliceGrowth growth() const { return _data->growth; }
+
+    // With copy on write, the non-const accessors count as writes
+    // (we can't tell what you are going to do with the reference).
+    // Use a const Slice (or std::as_const) to read without copying.
     T &operator[](size_t pos)
+    {
+        auto ret = element(pos);
+        if (_data->copy_on_write)
+        {
+            prepare_write(pos, pos + 1);
+            ret = element(pos);
+        }
+        return *ret;
+    }
+
+    const T &operator[](size_t pos) const
+    {
+        return *element(pos);
+    }
+
+    // No bounds checks at all: for hot loops where you already know
+    // pos is in range.  A loop over unchecked() (or over data(), or
+    // begin() to end()) is a loop over a plain array, which the
+    // compiler can vectorize.  operator[]'s checks and the exception
+    // they can throw get in the way of that.
+    T &unchecked(size_t pos)
+    {
+        prepare_write(pos, pos + 1);
+        return _data->base()[_start + pos];
+    }
+    const T &unchecked(size_t pos) const { return _data->base()[_start + pos]; }
+
+    // Our elements are always contiguous, so a plain pointer is a
+    // perfectly good random access (indeed contiguous) iterator, and
+    // this works with <algorithm>, ranges and range-based for.  Like
+    // vector iterators, these are invalidated if push_back has to
+    // reallocate.
+    T *data()
+    {
+        prepare_write(0, _len);
+        return _data->base() + _start;
+    }
+    const T *data() const { return _data->base() + _start; }
+    T *begin() { return data(); }
+    T *end() { return data() + _len; }
+    const T *begin() const { return data(); }
+    const T *end() const { return data() + _len; }
+
+    size_t size() const { return _len; }
+    bool empty() const { return _len == 0; }
+
+    // Since we are a contiguous sized range, std::span's own range
+    // constructor already converts a Slice implicitly.  This is just
+    // for when you want to say so.
+    std::span<T> span() { return std::span<T>(data(), _len); }
+    std::span<const T> span() const { return std::span<const T>(data(), _len); }
+
+private:
+    Slice(std::shared_ptr<SliceStorage<T>> data, size_t start, size_t len)
+        : _data(data), _start(start), _len(len)
+    {
+        attach();
+    }
+
+    T *element(size_t pos) const
     {
         if (pos >= _len)
             throw SliceOutOfBoundsException("Exceeded Bounds");
         if (pos + _start >= _data->size())
             throw SliceOutOfBoundsException("Exceeds Size");
-        return (*_data)[pos + _start];
+        return _data->base() + pos + _start;
     }
 
-private:
-    std::shared_ptr<std::vector<T>> _data;
+    // Copy on write bookkeeping: the storage knows the range of every
+    // slice using it.  Without copy on write these do nothing.
+    void attach()
+    {
+        _exclusive_since = 0;
+        if (_data->copy_on_write)
+        {
+            _data->views.insert({_start, _len});
+            _data->generation++;
+        }
+    }
+
+    void detach()
+    {
+        if (_data->copy_on_write)
+            _data->views.erase(_data->views.find({_start, _len}));
+    }
+
+    // How many elements the storage has after position end.
+    size_t room_after(size_t end) const
+    {
+        auto size = _data->size();
+        return end < size ? size - end : 0;
+    }
+
+    void check_growable() const
+    {
+        if (_data->is_borrowed)
+            throw SliceException("Can't grow a borrowed slice");
+    }
+
+    // Throws if we can't add extra elements, before we have changed
+    // anything.
+    void check_room(size_t extra) const
+    {
+        if (room_after(_start + _len) < extra)
+            check_growable();
+    }
+
+    // Makes room in the owned vector for extra more elements, following
+    // the growth policy rather than whatever vector would do.
+    void grow(size_t extra)
+    {
+        auto &owned = _data->owned;
+        auto needed = owned.size() + extra;
+        if (needed > owned.capacity())
+            owned.reserve(_data->growth.next(owned.capacity(), needed));
+    }
+
+    // Appends n elements starting at first.  The ones that land on
+    // existing elements of the storage overwrite them, and the rest
+    // are added on the end of the vector.
+    template <class It>
+    void append_items(It first, size_t n)
+    {
+        prepare_write(_len, _len + n);
+        check_room(n);
+        auto end = _start + _len;
+        auto over = std::min(room_after(end), n);
+        if constexpr (std::is_same_v<It, const T *> && std::is_trivially_copyable_v<T>)
+        {
+            if (over > 0)
+                std::memcpy(_data->base() + end, first, over * sizeof(T));
+        }
+        else
+        {
+            std::copy_n(first, over, _data->base() + end);
+        }
+        if (n > over)
+        {
+            auto rest = std::next(first, (std::ptrdiff_t)over);
+            grow(n - over);
+            // For pointers to trivially copyable T, vector's range
+            // insert is itself a memmove.
+            _data->owned.insert(_data->owned.end(), rest, std::next(rest, (std::ptrdiff_t)(n - over)));
+        }
+        detach();
+        _len += n;
+        attach();
+    }
+
+    // We are about to write to our elements [lo, hi).  If another
+    // slice can see any of them, we switch to a copy of our own first.
+    //
+    // Finding out means looking at every view, so once we know nobody
+    // else can see any of our elements we remember that (until a new
+    // view shows up), and a loop writing to them doesn't look again
+    // every time.
+    void prepare_write(size_t lo, size_t hi)
+    {
+        if (!_data->copy_on_write)
+            return;
+        if (hi <= _len)
+        {
+            if (_exclusive_since == _data->generation)
+                return;
+            if (_data->overlapping(_start, _start + _len) <= 1)
+            {
+                _exclusive_since = _data->generation;
+                return;
+            }
+        }
+        auto seen = _data->overlapping(_start + lo, _start + hi);
+        if (lo < _len)
+            seen--; // That's us.
+        if (seen == 0)
+            return;
+        auto from = _data->base() + _start;
+        auto mine = std::make_shared<SliceStorage<T>>(std::vector<T>(from, from + _len));
+        mine->copy_on_write = true;
+        mine->growth = _data->growth;
+        detach();
+        _data = mine;
+        _start = 0;
+        attach();
+        // Nobody else has this storage yet.
+        _exclusive_since = _data->generation;
+    }
+
+    static void check_range(int start, int end, size_t size)
+    {
+        if (start < 0)
+            throw SliceException("Negative Start");
+        if (end < start)
+            throw SliceException("End before start");
+        if ((size_t)end >= size)
+            throw SliceException("Can't have slice beyond end");
+    }
+
+    // absolute is where start ends up in the storage.
+    void set_range(int absolute, int start, int end)
+    {
+        if (absolute < 0)
+            throw SliceException("Negative Start");
+        if (end < start)
+            throw SliceException("End before start");
+        _start = (size_t)absolute;
+        _len = (size_t)end - start + 1;
+        if (_start + _len > _data->size())
+            throw SliceException("Can't have slice beyond end");
+    }
+
+    std::shared_ptr<SliceStorage<T>> _data;
     size_t _start;
     size_t _len;
+    // The storage's generation when we last found our elements were
+    // only ours (0 if we haven't, since every generation a slice can
+    // see is at least 1).
+    uint64_t _exclusive_since = 0;
 
 
 };
@@ -0,0 +1,246 @@
+#ifndef SLICE_ALGORITHMS_HPP
+#define SLICE_ALGORITHMS_HPP
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <optional>
+#include <vector>
+#include "slice.hpp"
+#include "threadpool.hpp"
+
+// Parallel versions of sort, transform, reduce and scan for Slices.
+//
+// They all work the same way: cut the slice into chunks, one piece of
+// work per chunk, and hand them to a ThreadPool (by default the shared
+// one).  There are a few chunks per thread so that one slow chunk
+// doesn't leave the other threads idle at the end.  Below
+// PARALLEL_GRAIN elements per chunk the overhead isn't worth it, so
+// small slices are just done on the calling thread.
+//
+// reduce and the scans apply op in a different grouping than a
+// sequential loop would, so op must be associative (+, *, min, max
+// are; floating point + is only approximately, so results can differ
+// in the last bits from std::accumulate).
+
+const size_t PARALLEL_GRAIN = 4096;
+
+// How many chunks to cut n elements into.
+inline size_t parallel_chunks(size_t n, ThreadPool &pool)
+{
+    auto most = (n + PARALLEL_GRAIN - 1) / PARALLEL_GRAIN;
+    return std::max((size_t)1, std::min(most, pool.size() * 4));
+}
+
+// The [lo, hi) of chunk c.
+inline std::pair<size_t, size_t> parallel_chunk(size_t n, size_t chunks, size_t c)
+{
+    return {n * c / chunks, n * (c + 1) / chunks};
+}
+
+// Merges the piece'th of pieces parts of a and b into out (which has
+// room for both).  a is cut evenly, and b where a's cut points would
+// go, so the pieces can all be merged at the same time.  Like
+// std::merge, on ties a's elements come first.
+template <class T, class Compare>
+void parallel_merge_piece(const T *a, size_t na, const T *b, size_t nb, T *out,
+                          size_t piece, size_t pieces, Compare &comp)
+{
+    auto split = [&](size_t k) -> std::pair<size_t, size_t>
+    {
+        auto ak = na * k / pieces;
+        if (k == 0)
+            return {0, 0};
+        if (ak >= na)
+            return {na, nb};
+        return {ak, (size_t)(std::lower_bound(b, b + nb, a[ak], comp) - b)};
+    };
+    auto [ai, bi] = split(piece);
+    auto [aj, bj] = split(piece + 1);
+    std::merge(a + ai, a + aj, b + bi, b + bj, out + ai + bi, comp);
+}
+
+// A merge sort.  Every chunk is sorted with std::sort, at the same
+// time, and then neighboring runs are merged pairwise until there is
+// only one.  Each round of merging is split into about the same
+// number of pieces (see parallel_merge_piece), so the last rounds,
+// with only one or two big merges, still use every thread.  It is
+// stable across chunks, but std::sort isn't stable within one.
+//
+// Needs a temporary copy of the slice.
+template <class T, class Compare = std::less<T>>
+void parallel_sort(Slice<T> &s, Compare comp = Compare(),
+                   ThreadPool &pool = ThreadPool::shared())
+{
+    auto n = s.size();
+    auto data = s.data();
+    auto runs = parallel_chunks(n, pool);
+    if (runs == 1)
+    {
+        std::sort(data, data + n, comp);
+        return;
+    }
+    pool.parallel_for((size_t)0, runs, [&](size_t r)
+                      {
+                        auto [lo, hi] = parallel_chunk(n, runs, r);
+                        std::sort(data + lo, data + hi, comp); });
+
+    std::vector<T> buffer(data, data + n);
+    T *from = data;
+    T *to = buffer.data();
+    auto pieces_per_round = pool.size() * 4;
+    // Runs are uneven by at most one element, so we track their
+    // boundaries rather than assume a width.
+    std::vector<size_t> bounds;
+    for (size_t r = 0; r <= runs; ++r)
+        bounds.push_back(n * r / runs);
+    while (bounds.size() > 2)
+    {
+        // An odd run out at the end is "merged" with nothing, which
+        // just copies it across.
+        auto pairs = bounds.size() / 2;
+        auto pieces = std::max((size_t)1, pieces_per_round / pairs);
+        pool.parallel_for((size_t)0, pairs * pieces, [&](size_t job)
+                          {
+                            auto p = job / pieces;
+                            auto lo = bounds[2 * p];
+                            auto mid = bounds[std::min(2 * p + 1, bounds.size() - 1)];
+                            auto hi = bounds[std::min(2 * p + 2, bounds.size() - 1)];
+                            parallel_merge_piece(from + lo, mid - lo, from + mid, hi - mid,
+                                                 to + lo, job % pieces, pieces, comp); });
+        std::vector<size_t> merged;
+        for (size_t i = 0; i < bounds.size(); i += 2)
+            merged.push_back(bounds[i]);
+        if (merged.back() != n)
+            merged.push_back(n);
+        bounds = merged;
+        std::swap(from, to);
+    }
+    if (from != data)
+    {
+        pool.parallel_for((size_t)0, runs, [&](size_t r)
+                          {
+                            auto [lo, hi] = parallel_chunk(n, runs, r);
+                            std::copy(from + lo, from + hi, data + lo); });
+    }
+}
+
+// out[i] = f(in[i]).  out needs to be at least as big as in, and can be
+// the same slice as in.
+template <class T, class U, class F>
+void parallel_transform(const Slice<T> &in, Slice<U> &out, F f,
+                        ThreadPool &pool = ThreadPool::shared())
+{
+    auto n = in.size();
+    if (out.size() < n)
+        throw SliceException("Output slice too small");
+    auto from = in.data();
+    auto to = out.data();
+    auto chunks = parallel_chunks(n, pool);
+    pool.parallel_for((size_t)0, chunks, [&](size_t c)
+                      {
+                        auto [lo, hi] = parallel_chunk(n, chunks, c);
+                        std::transform(from + lo, from + hi, to + lo, f); });
+}
+
+// init op s[0] op s[1] op ...
+template <class T, class Op = std::plus<T>>
+T parallel_reduce(const Slice<T> &s, T init, Op op = Op(),
+                  ThreadPool &pool = ThreadPool::shared())
+{
+    auto n = s.size();
+    auto data = s.data();
+    auto chunks = parallel_chunks(n, pool);
+    // Each chunk starts from its own first element, so we don't need
+    // an identity element for op.
+    std::vector<std::optional<T>> partial(chunks);
+    pool.parallel_for((size_t)0, chunks, [&](size_t c)
+                      {
+                        auto [lo, hi] = parallel_chunk(n, chunks, c);
+                        if (lo < hi)
+                            partial[c] = std::accumulate(data + lo + 1, data + hi, data[lo], op); });
+    for (auto &p : partial)
+    {
+        if (p)
+            init = op(init, *p);
+    }
+    return init;
+}
+
+// The scans go in three steps.  First every chunk is reduced (in
+// parallel), then a quick sequential pass turns the chunk totals into
+// the running total at the start of each chunk, and then every chunk
+// is scanned starting from that (in parallel again).  That reads the
+// input twice, but each pass is embarrassingly parallel.
+template <class T, class Op>
+void parallel_scan(const Slice<T> &in, Slice<T> &out, std::optional<T> init,
+                   Op op, bool inclusive, ThreadPool &pool)
+{
+    auto n = in.size();
+    if (out.size() < n)
+        throw SliceException("Output slice too small");
+    auto from = in.data();
+    auto to = out.data();
+    auto chunks = parallel_chunks(n, pool);
+
+    std::vector<std::optional<T>> carry(chunks);
+    if (chunks > 1)
+    {
+        std::vector<std::optional<T>> total(chunks);
+        pool.parallel_for((size_t)0, chunks, [&](size_t c)
+                          {
+                            auto [lo, hi] = parallel_chunk(n, chunks, c);
+                            if (lo < hi)
+                                total[c] = std::accumulate(from + lo + 1, from + hi, from[lo], op); });
+        auto running = init;
+        for (size_t c = 0; c < chunks; ++c)
+        {
+            carry[c] = running;
+            if (total[c])
+                running = running ? op(*running, *total[c]) : *total[c];
+        }
+    }
+    else
+    {
+        carry[0] = init;
+    }
+
+    pool.parallel_for((size_t)0, chunks, [&](size_t c)
+                      {
+                        auto [lo, hi] = parallel_chunk(n, chunks, c);
+                        auto running = carry[c];
+                        for (auto i = lo; i < hi; ++i)
+                        {
+                            // Read before writing, in case in and out are
+                            // the same slice.
+                            T x = from[i];
+                            if (inclusive)
+                            {
+                                running = running ? op(*running, x) : x;
+                                to[i] = *running;
+                            }
+                            else
+                            {
+                                to[i] = *running;
+                                running = op(*running, x);
+                            }
+                        } });
+}
+
+// out[i] = in[0] op ... op in[i]
+template <class T, class Op = std::plus<T>>
+void parallel_inclusive_scan(const Slice<T> &in, Slice<T> &out, Op op = Op(),
+                             ThreadPool &pool = ThreadPool::shared())
+{
+    parallel_scan(in, out, std::optional<T>(), op, true, pool);
+}
+
+// out[i] = init op in[0] op ... op in[i - 1], so out[0] is init.
+template <class T, class Op = std::plus<T>>
+void parallel_exclusive_scan(const Slice<T> &in, Slice<T> &out, T init, Op op = Op(),
+                             ThreadPool &pool = ThreadPool::shared())
+{
+    parallel_scan(in, out, std::optional<T>(init), op, false, pool);
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+#include "slice_algorithms.hpp"
+
+static Slice<int> random_slice(size_t n, int range, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<int> v(n);
+    for (auto &x : v)
+        x = (int)(rng() % (unsigned)range);
+    return Slice<int>(std::move(v));
+}
+
+TEST(SliceAlgorithms, Sort)
+{
+    ThreadPool pool(4);
+    // Empty, below the grain, odd numbers of runs, lots of duplicates.
+    for (size_t n : {0, 1, 100, 5000, 4096 * 3 + 7, 100000})
+    {
+        for (int range : {10, 1000000})
+        {
+            auto s = random_slice(n, range, (unsigned)n);
+            std::vector<int> expected(s.begin(), s.end());
+            std::sort(expected.begin(), expected.end());
+            parallel_sort(s, std::less<int>(), pool);
+            ASSERT_TRUE(std::equal(s.begin(), s.end(), expected.begin(), expected.end()))
+                << n << " " << range;
+        }
+    }
+
+    // A window of a bigger slice only sorts the window.
+    auto all = random_slice(50000, 1000, 7);
+    std::vector<int> before(all.begin(), all.end());
+    Slice<int> middle(all, 10000, 39999);
+    parallel_sort(middle, std::greater<int>(), pool);
+    EXPECT_TRUE(std::is_sorted(middle.begin(), middle.end(), std::greater<int>()));
+    EXPECT_TRUE(std::equal(before.begin(), before.begin() + 10000, all.begin()));
+    EXPECT_TRUE(std::equal(before.begin() + 40000, before.end(), all.begin() + 40000));
+}
+
+TEST(SliceAlgorithms, TransformAndReduce)
+{
+    ThreadPool pool(4);
+    auto s = random_slice(30000, 100, 1);
+    Slice<std::string> out{std::vector<std::string>(s.size())};
+    parallel_transform(s, out, [](int x)
+                       { return std::to_string(x); },
+                       pool);
+    for (size_t i = 0; i < s.size(); ++i)
+        ASSERT_EQ(out[(int)i], std::to_string(s[(int)i]));
+
+    // In place.
+    parallel_transform(s, s, [](int x)
+                       { return x * 2; },
+                       pool);
+    EXPECT_EQ(s[5] % 2, 0);
+
+    Slice<std::string> small{std::vector<std::string>(10)};
+    EXPECT_THROW(parallel_transform(s, small, [](int x)
+                                    { return std::to_string(x); },
+                                    pool),
+                 SliceException);
+
+    std::vector<int> v(s.begin(), s.end());
+    EXPECT_EQ(parallel_reduce(s, 17, std::plus<int>(), pool),
+              std::accumulate(v.begin(), v.end(), 17));
+    EXPECT_EQ(parallel_reduce(s, 0, [](int a, int b)
+                              { return std::max(a, b); },
+                              pool),
+              *std::max_element(v.begin(), v.end()));
+    EXPECT_EQ(parallel_reduce(Slice<int>(), 5, std::plus<int>(), pool), 5);
+}
+
+TEST(SliceAlgorithms, Scan)
+{
+    ThreadPool pool(4);
+    for (size_t n : {0, 1, 1000, 4096 * 5 + 3})
+    {
+        auto s = random_slice(n, 100, 3);
+        std::vector<int> v(s.begin(), s.end());
+
+        std::vector<int> inclusive(n), exclusive(n);
+        std::inclusive_scan(v.begin(), v.end(), inclusive.begin());
+        std::exclusive_scan(v.begin(), v.end(), exclusive.begin(), 10);
+
+        Slice<int> out{std::vector<int>(n)};
+        parallel_inclusive_scan(s, out, std::plus<int>(), pool);
+        ASSERT_TRUE(std::equal(out.begin(), out.end(), inclusive.begin(), inclusive.end())) << n;
+        parallel_exclusive_scan(s, out, 10, std::plus<int>(), pool);
+        ASSERT_TRUE(std::equal(out.begin(), out.end(), exclusive.begin(), exclusive.end())) << n;
+
+        // In place.
+        parallel_inclusive_scan(s, s, std::plus<int>(), pool);
+        ASSERT_TRUE(std::equal(s.begin(), s.end(), inclusive.begin(), inclusive.end())) << n;
+    }
+}
+
+// Not really a test: parallel_sort against std::sort.  Don't expect
+// much from a machine with one core.
+TEST(SliceAlgorithms, DISABLED_Benchmark)
+{
+    const size_t n = 400000;
+    auto a = random_slice(n, 1 << 30, 11);
+    auto b = random_slice(n, 1 << 30, 11);
+
+    auto start = std::chrono::steady_clock::now();
+    std::sort(a.begin(), a.end());
+    std::chrono::duration<double> sequential = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    parallel_sort(b);
+    std::chrono::duration<double> parallel = std::chrono::steady_clock::now() - start;
+
+    EXPECT_TRUE(std::equal(a.begin(), a.end(), b.begin(), b.end()));
+    std::cout << "std::sort " << sequential.count() << "s, parallel_sort on "
+              << ThreadPool::shared().size() << " threads " << parallel.count() << "s\n";
+}
@@ -2,6 +2,14 @@
 #include <string>
 #include "slice.hpp"
 #include <iostream>
+#include <algorithm>
+#include <ranges>
+#include <span>
+#include <utility>
+#include <list>
+#include <sstream>
+#include <numeric>
+#include <chrono>
 
 TEST(SliceTest, AppendingOnEnd)
 {
@@ -29,4 +37,258 @@ TEST(SliceTest, AppendingOnEnd)
     EXPECT_EQ(garplay[0], 2);
     EXPECT_EQ(garplay[1], 3);
     EXPECT_THROW(garplay[3], SliceOutOfBoundsException);
+    // Short enough, but it would run past the end of baz.
+    EXPECT_THROW(Slice<int>(baz, 1, 4), SliceException);
+    Slice<int> last(baz, 3, 3);
+    EXPECT_EQ(last[0], 4);
+}
+
+TEST(SliceTest, AdoptAndBorrow)
+{
+    std::vector<int> big(1000);
+    for (auto x = 0; x < 1000; ++x)
+        big[x] = x;
+    auto before = big.data();
+
+    // Adopting takes over the vector's buffer rather than copying it.
+    Slice<int> adopted(std::move(big), 10, 11);
+    EXPECT_TRUE(big.empty());
+    EXPECT_EQ(&adopted[0], before + 10);
+    EXPECT_EQ(adopted[1], 11);
+    EXPECT_THROW(adopted[2], SliceOutOfBoundsException);
+    EXPECT_THROW(Slice<int>(std::vector<int>({1, 2}), 0, 2), SliceException);
+
+    Slice<int> whole(std::vector<int>({1, 2, 3}));
+    EXPECT_EQ(whole[2], 3);
+    whole.push_back(4);
+    EXPECT_EQ(whole[3], 4);
+
+    // Borrowing doesn't copy either, and writes go to the original.
+    std::vector<int> mine({1, 2, 3, 4, 5});
+    auto view = Slice<int>::borrow(mine, 1, 2);
+    EXPECT_TRUE(view.is_borrowed());
+    EXPECT_EQ(&view[0], &mine[1]);
+    view[0] = 20;
+    EXPECT_EQ(mine[1], 20);
+    // Growing within what we borrowed overwrites, like any slice...
+    view.push_back(40);
+    EXPECT_EQ(mine[3], 40);
+    // ...but we can't grow past it.
+    auto all = Slice<int>::borrow(mine.data(), mine.size());
+    EXPECT_EQ(all[4], 5);
+    EXPECT_THROW(all.push_back(6), SliceException);
+    Slice<int> sub(all, 3, 4);
+    EXPECT_EQ(sub[0], 40);
+    EXPECT_THROW(Slice<int>(all, 3, 5), SliceException);
+}
+
+static int sum_span(std::span<const int> s)
+{
+    int ret = 0;
+    for (auto x : s)
+        ret += x;
+    return ret;
+}
+
+TEST(SliceTest, IteratorsAndSpans)
+{
+    static_assert(std::ranges::contiguous_range<Slice<int>>);
+    static_assert(std::ranges::sized_range<Slice<int>>);
+
+    Slice<int> foo;
+    for (auto x = 0; x < 10; ++x)
+        foo.push_back(9 - x);
+    Slice<int> bar(foo, 2, 6);
+    EXPECT_EQ(bar.size(), 5);
+    EXPECT_EQ(bar.data(), &foo[2]);
+    EXPECT_EQ(bar.end() - bar.begin(), 5);
+
+    // Sorting the sub-slice sorts that part of foo.
+    std::sort(bar.begin(), bar.end());
+    EXPECT_EQ(bar[0], 3);
+    EXPECT_EQ(foo[2], 3);
+    EXPECT_EQ(foo[6], 7);
+    EXPECT_EQ(foo[7], 2);
+    EXPECT_TRUE(std::ranges::is_sorted(bar));
+
+    EXPECT_EQ(sum_span(bar), 3 + 4 + 5 + 6 + 7);
+    std::span<int> s = bar;
+    s[0] = 30;
+    EXPECT_EQ(foo[2], 30);
+    EXPECT_EQ(bar.span().size(), 5);
+
+    int total = 0;
+    for (size_t i = 0; i < bar.size(); ++i)
+        total += bar.unchecked(i);
+    EXPECT_EQ(total, 30 + 4 + 5 + 6 + 7);
+
+    const Slice<int> &constant = bar;
+    EXPECT_EQ(constant[1], 4);
+    EXPECT_EQ(*constant.begin(), 30);
+    EXPECT_THROW(constant[5], SliceOutOfBoundsException);
+}
+
+TEST(SliceTest, CopyOnWrite)
+{
+    // The same as AppendingOnEnd, but this time bar's push_back must
+    // not show up in foo.
+    Slice<int> foo(SliceSharing::CopyOnWrite);
+    EXPECT_TRUE(foo.is_copy_on_write());
+    for (auto x = 0; x < 10; ++x)
+        foo.push_back(x);
+    Slice<int> bar(foo, 1, 4);
+    EXPECT_TRUE(bar.is_copy_on_write());
+    EXPECT_EQ(std::as_const(bar).data(), std::as_const(foo).data() + 1);
+    bar.push_back(32);
+    EXPECT_EQ(foo[5], 5);
+    EXPECT_EQ(bar[4], 32);
+    for (auto x = 0; x < 4; ++x)
+        EXPECT_EQ(bar[x], x + 1);
+
+    // Writing to an element only we can see happens in place.
+    Slice<int> baz(foo, 0, 4);
+    Slice<int> garplay(foo, 6, 9);
+    auto before = std::as_const(baz).data();
+    baz[0] = 100;
+    // foo can see element 0 though, so baz had to copy.
+    EXPECT_NE(std::as_const(baz).data(), before);
+    EXPECT_EQ(foo[0], 0);
+    EXPECT_EQ(baz[0], 100);
+
+    // Now foo writes.  garplay overlaps element 7, so foo copies, and
+    // then garplay is the only one left on the old storage.
+    foo[7] = 70;
+    EXPECT_EQ(garplay[1], 7);
+    auto old = std::as_const(garplay).data();
+    garplay[1] = 71;
+    EXPECT_EQ(std::as_const(garplay).data(), old);
+    EXPECT_EQ(foo[7], 70);
+
+    // Copies are independent values too.
+    Slice<int> copy = foo;
+    copy[0] = -1;
+    EXPECT_EQ(foo[0], 0);
+    EXPECT_EQ(copy[0], -1);
+
+    // Reading through a const slice never copies.
+    Slice<int> other = foo;
+    EXPECT_EQ(std::as_const(other)[3], 3);
+    EXPECT_EQ(std::as_const(other).data(), std::as_const(foo).data());
+
+    // Once copy knows it has its elements to itself it stops looking,
+    // but a new view of them still has to make it look again.
+    auto mine = std::as_const(copy).data();
+    for (auto x = 0; x < 10; ++x)
+        copy[(size_t)x] = x * 10;
+    EXPECT_EQ(std::as_const(copy).data(), mine);
+    Slice<int> view(copy, 2, 3);
+    copy[2] = 7;
+    EXPECT_NE(std::as_const(copy).data(), mine);
+    EXPECT_EQ(view[0], 20);
+    EXPECT_EQ(copy[2], 7);
+}
+
+TEST(SliceTest, AppendReserveResize)
+{
+    Slice<int> foo;
+    std::vector<int> v{1, 2, 3, 4};
+    foo.append(v);
+    foo.append(std::list<int>{5, 6});
+    std::istringstream in("7 8 9");
+    foo.append(std::views::istream<int>(in));
+    foo.append(std::views::iota(10, 12) | std::views::transform([](int x)
+                                                               { return x; }));
+    ASSERT_EQ(foo.size(), 11u);
+    for (auto x = 0; x < 11; ++x)
+        EXPECT_EQ(foo[x], x + 1);
+
+    // Appending ourselves has to survive the storage moving.
+    foo.append(foo);
+    ASSERT_EQ(foo.size(), 22u);
+    EXPECT_EQ(foo[11], 1);
+    EXPECT_EQ(foo[21], 11);
+
+    // Like push_back, appending to a sub-slice overwrites what follows.
+    Slice<int> bar(foo, 0, 1);
+    bar.append(std::vector<int>{-3, -4});
+    EXPECT_EQ(foo[2], -3);
+    EXPECT_EQ(foo[3], -4);
+    EXPECT_EQ(foo.size(), 22u);
+    // ... and grows the storage once it runs off the end of it.
+    Slice<int> baz(foo, 20, 21);
+    baz.append(std::vector<int>{100, 101, 102});
+    EXPECT_EQ(baz.size(), 5u);
+    EXPECT_EQ(baz[4], 102);
+
+    // reserve means no reallocation.
+    Slice<int> big;
+    big.reserve(1000);
+    EXPECT_GE(big.capacity(), 1000u);
+    auto where = std::as_const(big).data();
+    for (auto x = 0; x < 1000; ++x)
+        big.push_back(x);
+    EXPECT_EQ(std::as_const(big).data(), where);
+
+    // The growth policy.
+    Slice<int> slow;
+    slow.set_growth(SliceGrowth{1.5, 64});
+    slow.push_back(1);
+    EXPECT_EQ(slow.capacity(), 64u);
+    slow.resize(65, 7);
+    EXPECT_EQ(slow.capacity(), 96u);
+    EXPECT_EQ(slow[64], 7);
+    EXPECT_EQ(slow[0], 1);
+
+    // Shrinking leaves the storage alone.
+    slow.resize(2);
+    EXPECT_EQ(slow.size(), 2u);
+    EXPECT_EQ(slow.capacity(), 96u);
+    EXPECT_EQ(slow[1], 7);
+    EXPECT_THROW(slow[2], SliceOutOfBoundsException);
+
+    // Borrowed slices can't grow, and don't change if we try.
+    int raw[3] = {1, 2, 3};
+    auto all = Slice<int>::borrow(raw, 3);
+    Slice<int> b(all, 0, 1);
+    b.append(std::vector<int>{9});
+    EXPECT_EQ(raw[2], 9);
+    EXPECT_THROW(b.append(std::vector<int>{10}), SliceException);
+    EXPECT_EQ(b.size(), 3u);
+    EXPECT_THROW(b.reserve(4), SliceException);
+
+    // With copy on write, appending leaves others alone.
+    Slice<int> cow(SliceSharing::CopyOnWrite);
+    cow.append(std::vector<int>{1, 2, 3, 4});
+    Slice<int> head(cow, 0, 1);
+    head.append(std::vector<int>{-1, -2});
+    EXPECT_EQ(cow[2], 3);
+    EXPECT_EQ(head[2], -1);
+}
+
+// Not really a test: filling a big slice with push_back, with
+// reserve + push_back, and with append.
+TEST(SliceTest, DISABLED_FillBenchmark)
+{
+    const size_t n = 10000000;
+    std::vector<int> source(n);
+    std::iota(source.begin(), source.end(), 0);
+
+    auto time = [](auto f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    Slice<int> a, b, c;
+    auto pushed = time([&]()
+                       { for (auto x : source) a.push_back(x); });
+    auto reserved = time([&]()
+                         { b.reserve(n); for (auto x : source) b.push_back(x); });
+    auto appended = time([&]()
+                         { c.append(source); });
+    EXPECT_EQ(a.size(), n);
+    EXPECT_EQ(b.size(), n);
+    EXPECT_TRUE(std::equal(a.begin(), a.end(), c.begin(), c.end()));
+    std::cout << "push_back " << pushed << "s, reserve + push_back " << reserved
+              << "s, append " << appended << "s\n";
 }
@@ -0,0 +1,163 @@
+#ifndef SOA_SLICE_HPP
+#define SOA_SLICE_HPP
+
+#include <tuple>
+#include <utility>
+#include <iterator>
+#include <cstddef>
+#include "slice.hpp"
+
+// A slice of records stored "structure of arrays" style: rather than
+// one Slice<Record> with the fields of each record next to each
+// other, there is one Slice per field (a column), all the same
+// length.
+//
+//    SoaSlice<long, long, double> ticks;   // id, timestamp, value
+//    ticks.push_back(1, 1700000000, 3.5);
+//    double total = 0;
+//    for (auto v : ticks.column<2>())
+//        total += v;
+//
+// A loop over one field of a Slice<Record> drags every other field
+// through the cache with it, since they share cache lines.  A loop
+// over a column reads only the bytes it needs, and it is a loop over
+// a plain array of one type, which the compiler can vectorize.  The
+// price is that touching a whole record now means touching one
+// cache line per field.
+//
+// s[i] gives a tuple of references to the fields, so
+//    auto [id, time, value] = s[i];
+// works, and writing through it writes to the columns.
+//
+// Sub-slices work like Slice's: SoaSlice(s, start, end) cuts the same
+// range out of every column, sharing the storage, and everything
+// Slice says about aliasing and copy on write applies column by
+// column.
+template <class... Fields>
+class SoaSlice
+{
+    static_assert(sizeof...(Fields) > 0, "Need at least one field");
+
+public:
+    using Reference = std::tuple<Fields &...>;
+    using ConstReference = std::tuple<const Fields &...>;
+    using Value = std::tuple<Fields...>;
+
+    SoaSlice() {}
+
+    SoaSlice(SliceSharing how) : columns(Slice<Fields>(how)...) {}
+
+    // Subrange, inclusive of end like Slice's.
+    SoaSlice(SoaSlice &s, int start, int end)
+        : columns(std::apply([&](Slice<Fields> &...c)
+                             { return std::tuple<Slice<Fields>...>(Slice<Fields>(c, start, end)...); },
+                             s.columns))
+    {
+    }
+
+    void push_back(const Fields &...values)
+    {
+        push_each(std::index_sequence_for<Fields...>(), values...);
+    }
+
+    void push_back(const Value &values)
+    {
+        std::apply([this](const Fields &...v)
+                   { push_back(v...); },
+                   values);
+    }
+
+    void reserve(size_t n)
+    {
+        std::apply([n](Slice<Fields> &...c)
+                   { (c.reserve(n), ...); },
+                   columns);
+    }
+
+    void resize(size_t n)
+    {
+        std::apply([n](Slice<Fields> &...c)
+                   { (c.resize(n), ...); },
+                   columns);
+    }
+
+    size_t size() const { return std::get<0>(columns).size(); }
+    bool empty() const { return size() == 0; }
+
+    // The column for field I.  Use it for scans over one field.  It is
+    // a reference to our own Slice so that its data() stays valid, but
+    // don't change its length: that's what keeps the columns in step.
+    template <size_t I>
+    auto &column() { return std::get<I>(columns); }
+    template <size_t I>
+    const auto &column() const { return std::get<I>(columns); }
+
+    // Bounds checked, like Slice's operator[].
+    Reference operator[](size_t pos)
+    {
+        return std::apply([pos](Slice<Fields> &...c)
+                          { return Reference(c[pos]...); },
+                          columns);
+    }
+
+    ConstReference operator[](size_t pos) const
+    {
+        return std::apply([pos](const Slice<Fields> &...c)
+                          { return ConstReference(c[pos]...); },
+                          columns);
+    }
+
+    // Gathers record pos from the columns into a tuple of values.
+    Value get(size_t pos) const { return Value((*this)[pos]); }
+
+    // Iterates over the records, giving tuples of references.  Handy
+    // when you want whole records, but for scans over one field use
+    // column().
+    template <bool Const>
+    class Iterator
+    {
+    public:
+        using Owner = std::conditional_t<Const, const SoaSlice, SoaSlice>;
+        using value_type = Value;
+        using reference = std::conditional_t<Const, ConstReference, Reference>;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::input_iterator_tag;
+
+        Iterator() {}
+        Iterator(Owner *owner, size_t pos) : owner(owner), pos(pos) {}
+
+        reference operator*() const { return (*owner)[pos]; }
+        Iterator &operator++()
+        {
+            ++pos;
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            auto ret = *this;
+            ++pos;
+            return ret;
+        }
+        bool operator==(const Iterator &other) const { return pos == other.pos; }
+
+    private:
+        Owner *owner = nullptr;
+        size_t pos = 0;
+    };
+
+    Iterator<false> begin() { return Iterator<false>(this, 0); }
+    Iterator<false> end() { return Iterator<false>(this, size()); }
+    Iterator<true> begin() const { return Iterator<true>(this, 0); }
+    Iterator<true> end() const { return Iterator<true>(this, size()); }
+
+private:
+    template <size_t... I>
+    void push_each(std::index_sequence<I...>, const Fields &...values)
+    {
+        (std::get<I>(columns).push_back(values), ...);
+    }
+
+    std::tuple<Slice<Fields>...> columns;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <utility>
+#include "soa_slice.hpp"
+
+TEST(SoaSlice, RecordsAndColumns)
+{
+    SoaSlice<long, long, double> ticks;
+    for (auto x = 0; x < 10; ++x)
+        ticks.push_back(x, 1000 + x, x * 0.5);
+    ticks.push_back(std::make_tuple(10L, 1010L, 5.0));
+    ASSERT_EQ(ticks.size(), 11u);
+
+    auto [id, time, value] = ticks[3];
+    EXPECT_EQ(id, 3);
+    EXPECT_EQ(time, 1003);
+    EXPECT_EQ(value, 1.5);
+    // Those are references into the columns.
+    value = 42;
+    EXPECT_EQ(ticks.column<2>()[3], 42);
+    EXPECT_EQ(ticks.get(3), std::make_tuple(3L, 1003L, 42.0));
+    EXPECT_THROW(ticks[11], SliceOutOfBoundsException);
+
+    // Each column is one contiguous array.
+    auto &ids = ticks.column<0>();
+    EXPECT_EQ(std::accumulate(ids.begin(), ids.end(), 0L), 55);
+
+    long count = 0;
+    for (auto [i, t, v] : std::as_const(ticks))
+    {
+        EXPECT_EQ(t, 1000 + i);
+        (void)v;
+        count++;
+    }
+    EXPECT_EQ(count, 11);
+    for (auto [i, t, v] : ticks)
+        t = i;
+    EXPECT_EQ(ticks.column<1>()[7], 7);
+}
+
+TEST(SoaSlice, SubSlices)
+{
+    SoaSlice<int, char> all;
+    for (auto x = 0; x < 10; ++x)
+        all.push_back(x, (char)('a' + x));
+
+    // Aliased like a Slice: writes and push_back show through.
+    SoaSlice<int, char> part(all, 2, 4);
+    ASSERT_EQ(part.size(), 3u);
+    EXPECT_EQ(part.get(0), std::make_tuple(2, 'c'));
+    std::get<0>(part[0]) = 20;
+    EXPECT_EQ(all.column<0>()[2], 20);
+    part.push_back(-1, '?');
+    EXPECT_EQ(all.get(5), std::make_tuple(-1, '?'));
+    using Pair = SoaSlice<int, char>;
+    EXPECT_THROW(Pair(all, 5, 20), SliceException);
+
+    // With copy on write they are values.
+    SoaSlice<int, char> cow(SliceSharing::CopyOnWrite);
+    for (auto x = 0; x < 10; ++x)
+        cow.push_back(x, (char)('a' + x));
+    SoaSlice<int, char> mine(cow, 2, 4);
+    std::get<1>(mine[0]) = 'Z';
+    EXPECT_EQ(std::get<1>(mine[0]), 'Z');
+    EXPECT_EQ(std::get<1>(cow[2]), 'c');
+
+    all.reserve(100);
+    EXPECT_GE(all.column<1>().capacity(), 100u);
+    all.resize(3);
+    EXPECT_EQ(all.size(), 3u);
+    EXPECT_EQ(all.column<1>().size(), 3u);
+}
+
+// Not really a test: summing one field of a Slice of structs against
+// summing the same field's column.
+TEST(SoaSlice, DISABLED_Benchmark)
+{
+    struct Tick
+    {
+        long id;
+        long timestamp;
+        double value;
+    };
+    const size_t n = 2000000;
+    Slice<Tick> aos;
+    SoaSlice<long, long, double> soa;
+    aos.reserve(n);
+    soa.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        aos.push_back(Tick{(long)i, (long)i * 10, (double)(i % 100)});
+        soa.push_back((long)i, (long)i * 10, (double)(i % 100));
+    }
+
+    auto time = [](auto f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto ret = f();
+        return std::make_pair(ret, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    };
+    auto [aos_sum, aos_time] = time([&]()
+                                    {
+                                        double sum = 0;
+                                        for (auto &t : std::as_const(aos))
+                                            sum += t.value;
+                                        return sum; });
+    auto [soa_sum, soa_time] = time([&]()
+                                    {
+                                        double sum = 0;
+                                        for (auto v : std::as_const(soa).column<2>())
+                                            sum += v;
+                                        return sum; });
+    EXPECT_EQ(aos_sum, soa_sum);
+    std::cout << "sum of one field: Slice<struct> " << aos_time << "s, SoaSlice column "
+              << soa_time << "s\n";
+}
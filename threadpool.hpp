@@ -0,0 +1,457 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <future>
+#include <thread>
+#include <optional>
+#include <type_traits>
+#include <algorithm>
+#include <coroutine>
+#include "workqueue.hpp"
+
+// A Chase-Lev work stealing deque (Chase and Lev, "Dynamic Circular
+// Work-Stealing Deque", 2005, using the C11 memory orderings worked
+// out by Le, Pop, Cohen and Zappa Nardelli in 2013).
+//
+// Exactly one thread, the owner, may push() and pop(), and it works
+// on the bottom like a stack.  Any other thread may steal() from the
+// top.  The owner never takes a lock, and only contends with thieves
+// when there is a single element left.
+//
+// Because elements are read and written as atomics T needs to be
+// trivially copyable, in practice a pointer.
+template <class T>
+class WorkStealingDeque
+{
+public:
+    WorkStealingDeque(size_t initial_capacity = 64)
+    {
+        size_t capacity = 1;
+        while (capacity < initial_capacity)
+            capacity *= 2;
+        rings.push_back(std::make_unique<Ring>(capacity));
+        array.store(rings.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    void operator=(const WorkStealingDeque &) = delete;
+
+    // Owner only.
+    void push(T item)
+    {
+        auto b = bottom.load(std::memory_order_relaxed);
+        auto t = top.load(std::memory_order_acquire);
+        auto a = array.load(std::memory_order_relaxed);
+        if (b - t > (int64_t)a->capacity - 1)
+        {
+            a = grow(a, b, t);
+        }
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only.  Takes the most recently pushed item.
+    std::optional<T> pop()
+    {
+        auto b = bottom.load(std::memory_order_relaxed) - 1;
+        auto a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto t = top.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            // Was already empty.
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        std::optional<T> ret = a->get(b);
+        if (t == b)
+        {
+            // Last element, so we race the thieves for it.
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                             std::memory_order_relaxed))
+                ret = std::nullopt;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return ret;
+    }
+
+    // Any thread.  Takes the oldest item.  Can fail spuriously if
+    // another thief (or the owner) got there first.
+    std::optional<T> steal()
+    {
+        auto t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return std::nullopt;
+        auto a = array.load(std::memory_order_acquire);
+        T ret = a->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                         std::memory_order_relaxed))
+            return std::nullopt;
+        return ret;
+    }
+
+    bool empty() const
+    {
+        return bottom.load(std::memory_order_relaxed) <=
+               top.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Ring
+    {
+        size_t capacity;
+        std::unique_ptr<std::atomic<T>[]> items;
+
+        Ring(size_t size) : capacity(size), items(new std::atomic<T>[size]) {}
+
+        T get(int64_t i) const
+        {
+            return items[(size_t)i & (capacity - 1)].load(std::memory_order_relaxed);
+        }
+        void put(int64_t i, T item)
+        {
+            items[(size_t)i & (capacity - 1)].store(item, std::memory_order_relaxed);
+        }
+    };
+
+    // A thief may still be reading the old ring, so we can't free
+    // it.  Instead we keep every ring we have ever used until the
+    // deque goes away.  Since they double in size this is at most
+    // twice the memory of the biggest one.
+    Ring *grow(Ring *old, int64_t b, int64_t t)
+    {
+        rings.push_back(std::make_unique<Ring>(old->capacity * 2));
+        auto ret = rings.back().get();
+        for (auto i = t; i < b; ++i)
+            ret->put(i, old->get(i));
+        array.store(ret, std::memory_order_release);
+        return ret;
+    }
+
+    std::atomic<int64_t> top = 0;
+    std::atomic<int64_t> bottom = 0;
+    std::atomic<Ring *> array;
+    std::vector<std::unique_ptr<Ring>> rings;
+};
+
+// A work stealing thread pool.
+//
+// Every worker has its own WorkStealingDeque.  Work submitted from
+// inside a task goes onto the submitting worker's own deque, which
+// it takes back off LIFO (good for cache locality, and for recursive
+// divide and conquer).  Work submitted from outside the pool goes onto
+// a shared injection WorkQueue.  An idle worker first checks its own
+// deque, then the injection queue, then tries to steal from the other
+// workers starting at a random one.  So on fine grained work almost
+// every operation is on a deque nobody else is touching.
+//
+// If nothing is found anywhere the worker goes to sleep until there
+// is work pending again.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t threads = std::thread::hardware_concurrency())
+    {
+        if (threads == 0)
+            threads = 1;
+        for (size_t i = 0; i < threads; ++i)
+        {
+            workers.push_back(std::make_unique<Worker>());
+            workers.back()->seed = i * 0x9e3779b97f4a7c15ULL + 1;
+        }
+        // Only start the threads once every deque exists, as they will
+        // immediately go looking at each other's.
+        for (size_t i = 0; i < threads; ++i)
+        {
+            workers[i]->thread = std::thread([this, i]()
+                                             { worker_loop(i); });
+        }
+    }
+
+    // Like WorkQueue, a pool isn't copyable or movable: the
+    // threads have pointers back to it.
+    ThreadPool(const ThreadPool &) = delete;
+    void operator=(const ThreadPool &) = delete;
+
+    // Everything already submitted gets run before the threads exit.
+    ~ThreadPool()
+    {
+        stopping = true;
+        {
+            std::unique_lock l(sleep_lock);
+        }
+        wake.notify_all();
+        for (auto &w : workers)
+            w->thread.join();
+    }
+
+    // A process wide pool sized to the machine, for algorithms that
+    // just want "run this in parallel".
+    static ThreadPool &shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    size_t size() const { return workers.size(); }
+
+    // Fire and forget.  An exception escaping the task terminates the
+    // program, just as it would for a std::thread.
+    void post(std::function<void()> task)
+    {
+        auto t = new Task(std::move(task));
+        // Counted before it is visible, so pending never goes negative.
+        pending.fetch_add(1);
+        if (current_pool == this)
+            workers[current_index]->deque.push(t);
+        else
+            injection.put(t);
+        if (sleepers.load() > 0)
+        {
+            // Taking the lock makes sure the sleeper is really
+            // waiting, not in between its check and its wait.
+            {
+                std::unique_lock l(sleep_lock);
+            }
+            wake.notify_one();
+        }
+    }
+
+    // For WorkQueue::set_executor: resumes coroutines on the pool.
+    std::function<void(std::coroutine_handle<>)> executor()
+    {
+        return [this](std::coroutine_handle<> h)
+        {
+            post([h]()
+                 { h.resume(); });
+        };
+    }
+
+    // co_await pool.schedule() moves the coroutine onto the pool.
+    // It is how a coroutine started on some other thread gets going
+    // on a worker.
+    auto schedule()
+    {
+        struct Awaiter
+        {
+            ThreadPool &pool;
+            bool await_ready() { return false; }
+            void await_suspend(std::coroutine_handle<> h)
+            {
+                pool.post([h]()
+                          { h.resume(); });
+            }
+            void await_resume() {}
+        };
+        return Awaiter{*this};
+    }
+
+    // Runs f(args...) on the pool.  The future holds the result, or
+    // the exception if f threw.
+    template <class F, class... Args>
+    auto submit(F &&f, Args &&...args) -> std::future<std::invoke_result_t<F, Args...>>
+    {
+        using R = std::invoke_result_t<F, Args...>;
+        // std::function must be copyable but a packaged_task is
+        // only movable, hence the shared_ptr.
+        auto task = std::make_shared<std::packaged_task<R()>>(
+            [f = std::forward<F>(f), ... args = std::forward<Args>(args)]() mutable
+            { return std::invoke(std::move(f), std::move(args)...); });
+        auto ret = task->get_future();
+        post([task]()
+             { (*task)(); });
+        return ret;
+    }
+
+    // Calls f(i) for every i in [begin, end), split into chunks of at
+    // least grain indices.  The calling thread works on chunks too
+    // while it waits, so it is safe to call from inside a task (a
+    // nested parallel_for can't deadlock the pool).  If any call
+    // throws, the first exception is rethrown here once all chunks
+    // are done.
+    template <class Index, class F>
+    void parallel_for(Index begin, Index end, F &&f, size_t grain = 1)
+    {
+        if (!(begin < end))
+            return;
+        size_t n = (size_t)(end - begin);
+        grain = std::max(grain, (size_t)1);
+        // A few chunks per worker evens out the load if some chunks
+        // are slower than others.
+        size_t chunks = std::min((n + grain - 1) / grain, workers.size() * 4);
+        chunks = std::max(chunks, (size_t)1);
+        size_t per_chunk = n / chunks;
+        size_t extra = n % chunks;
+
+        std::atomic<size_t> remaining = chunks;
+        std::exception_ptr error = nullptr;
+        std::mutex error_lock;
+        auto run = [&](size_t lo, size_t hi)
+        {
+            try
+            {
+                for (auto i = lo; i < hi; ++i)
+                    f((Index)(begin + (Index)i));
+            }
+            catch (...)
+            {
+                std::unique_lock l(error_lock);
+                if (!error)
+                    error = std::current_exception();
+            }
+            remaining.fetch_sub(1, std::memory_order_release);
+        };
+
+        size_t lo = 0;
+        for (size_t c = 0; c < chunks; ++c)
+        {
+            size_t hi = lo + per_chunk + (c < extra ? 1 : 0);
+            // We keep the last chunk for ourselves.
+            if (c + 1 == chunks)
+                run(lo, hi);
+            else
+                post([&run, lo, hi]()
+                     { run(lo, hi); });
+            lo = hi;
+        }
+        while (remaining.load(std::memory_order_acquire) > 0)
+        {
+            if (!run_pending_task())
+                std::this_thread::yield();
+        }
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    // Runs one queued task on the calling thread, if it can find one.
+    // This is how a thread that is waiting on the pool helps out.
+    bool run_pending_task()
+    {
+        auto t = find_task(current_pool == this ? current_index : NOT_A_WORKER);
+        if (!t)
+            return false;
+        run_task(t);
+        return true;
+    }
+
+private:
+    using Task = std::function<void()>;
+    static constexpr size_t NOT_A_WORKER = (size_t)-1;
+
+    struct Worker
+    {
+        WorkStealingDeque<Task *> deque;
+        std::thread thread;
+        uint64_t seed;
+    };
+
+    void run_task(Task *t)
+    {
+        std::unique_ptr<Task> owned(t);
+        (*owned)();
+    }
+
+    // Xorshift, just to scatter the thieves.
+    static size_t next_random(uint64_t &state)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return (size_t)state;
+    }
+
+    Task *find_task(size_t self)
+    {
+        std::optional<Task *> ret;
+        if (self != NOT_A_WORKER)
+            ret = workers[self]->deque.pop();
+        if (!ret)
+            ret = injection.try_get();
+        if (!ret)
+        {
+            thread_local uint64_t outsider_seed = 0x2545f4914f6cdd1dULL;
+            auto &seed = self != NOT_A_WORKER ? workers[self]->seed : outsider_seed;
+            auto start = next_random(seed);
+            for (size_t i = 0; i < workers.size() && !ret; ++i)
+            {
+                auto victim = (start + i) % workers.size();
+                if (victim != self)
+                    ret = workers[victim]->deque.steal();
+            }
+        }
+        if (!ret)
+            return nullptr;
+        pending.fetch_sub(1);
+        return *ret;
+    }
+
+    void worker_loop(size_t index)
+    {
+        current_pool = this;
+        current_index = index;
+        while (true)
+        {
+            auto t = find_task(index);
+            if (t)
+            {
+                run_task(t);
+                continue;
+            }
+            std::unique_lock l(sleep_lock);
+            sleepers++;
+            wake.wait(l, [this]()
+                      { return pending.load() > 0 || stopping; });
+            sleepers--;
+            if (stopping && pending.load() == 0)
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    WorkQueue<Task *> injection;
+
+    // Tasks that have been posted but not yet picked up.  Workers only
+    // sleep when this is 0, and posters only bother waking somebody
+    // when there are sleepers.
+    std::atomic<size_t> pending = 0;
+    std::atomic<size_t> sleepers = 0;
+    std::atomic<bool> stopping = false;
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+
+    static inline thread_local ThreadPool *current_pool = nullptr;
+    static inline thread_local size_t current_index = NOT_A_WORKER;
+};
+
+// The simplest possible coroutine type: it starts running right away,
+// nobody waits for it, and its frame is freed when it finishes.  As
+// with ThreadPool::post(), an exception escaping it terminates the
+// program.
+//
+//    DetachedCoroutine consumer(WorkQueue<int> &q, ThreadPool &pool)
+//    {
+//        co_await pool.schedule();
+//        while (true)
+//            handle(co_await q.async_get());
+//    }
+struct DetachedCoroutine
+{
+    struct promise_type
+    {
+        DetachedCoroutine get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+#endif
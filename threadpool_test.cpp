@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include <numeric>
+#include <ranges>
+#include <set>
+#include <stdexcept>
+#include "threadpool.hpp"
+
+TEST(WorkStealingDeque, OwnerAndThief)
+{
+    WorkStealingDeque<int *> d(2);
+    int items[100];
+    EXPECT_FALSE(d.pop());
+    EXPECT_FALSE(d.steal());
+    // More than the initial capacity, so it has to grow.
+    for (auto i : std::views::iota(0, 100))
+    {
+        d.push(&items[i]);
+    }
+    // The owner takes from the bottom, thieves from the top.
+    EXPECT_EQ(d.pop(), &items[99]);
+    EXPECT_EQ(d.steal(), &items[0]);
+    EXPECT_EQ(d.steal(), &items[1]);
+    EXPECT_EQ(d.pop(), &items[98]);
+}
+
+TEST(WorkStealingDeque, ConcurrentSteals)
+{
+    const int count = 100000;
+    std::vector<int> items(count);
+    WorkStealingDeque<int *> d;
+    std::atomic<int> taken = 0;
+    std::atomic<bool> done = false;
+    std::vector<std::atomic<int>> seen(count);
+    {
+        std::vector<std::jthread> thieves;
+        for (auto t : std::views::iota(0, 3))
+        {
+            (void)t;
+            thieves.emplace_back([&]()
+                                 {
+                                    while (!done || !d.empty())
+                                    {
+                                        auto got = d.steal();
+                                        if (got)
+                                        {
+                                            seen[*got - items.data()]++;
+                                            taken++;
+                                        }
+                                    } });
+        }
+        for (auto i : std::views::iota(0, count))
+        {
+            d.push(&items[i]);
+            if (i % 3 == 0)
+            {
+                auto got = d.pop();
+                if (got)
+                {
+                    seen[*got - items.data()]++;
+                    taken++;
+                }
+            }
+        }
+        done = true;
+    }
+    // Every item is taken exactly once by somebody.
+    EXPECT_EQ(taken, count);
+    for (auto &s : seen)
+    {
+        EXPECT_EQ(s, 1);
+    }
+}
+
+TEST(ThreadPool, SubmitReturnsFutures)
+{
+    ThreadPool pool(4);
+    std::vector<std::future<int>> results;
+    for (auto i : std::views::iota(0, 100))
+    {
+        results.push_back(pool.submit([](int x)
+                                      { return x * x; },
+                                      i));
+    }
+    for (auto i : std::views::iota(0, 100))
+    {
+        EXPECT_EQ(results[i].get(), i * i);
+    }
+    auto failing = pool.submit([]() -> int
+                               { throw std::domain_error("oops"); });
+    EXPECT_THROW(failing.get(), std::domain_error);
+}
+
+TEST(ThreadPool, ParallelFor)
+{
+    ThreadPool pool(4);
+    std::vector<int> data(100000);
+    pool.parallel_for(0, (int)data.size(), [&](int i)
+                      { data[i] = i; });
+    for (auto i : std::views::iota(0, (int)data.size()))
+    {
+        ASSERT_EQ(data[i], i);
+    }
+
+    // Nothing to do is fine too.
+    pool.parallel_for(10, 10, [](int)
+                      { FAIL(); });
+
+    EXPECT_THROW(pool.parallel_for(0, 1000, [](int i)
+                                   { if (i == 500) throw std::domain_error("oops"); }),
+                 std::domain_error);
+}
+
+TEST(ThreadPool, NestedParallelFor)
+{
+    // Every worker blocks in an inner parallel_for, which only works
+    // because waiting threads run tasks themselves.
+    ThreadPool pool(2);
+    std::atomic<long> total = 0;
+    pool.parallel_for(0, 16, [&](int)
+                      { pool.parallel_for(0, 1000, [&](int j)
+                                          { total += j; }); });
+    EXPECT_EQ(total, 16L * 999 * 1000 / 2);
+
+    auto f = pool.submit([&]()
+                         {
+                            std::atomic<int> inner = 0;
+                            pool.parallel_for(0, 100, [&](int) { inner++; });
+                            return inner.load(); });
+    EXPECT_EQ(f.get(), 100);
+}
+
+TEST(ThreadPool, FinishesWorkOnDestruction)
+{
+    std::atomic<int> ran = 0;
+    {
+        ThreadPool pool(3);
+        for (auto i : std::views::iota(0, 1000))
+        {
+            (void)i;
+            pool.post([&]()
+                      { ran++; });
+        }
+    }
+    EXPECT_EQ(ran, 1000);
+}
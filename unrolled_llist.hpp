@@ -0,0 +1,219 @@
+#ifndef UNROLLED_LLIST_HPP
+#define UNROLLED_LLIST_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include "llist.hpp"
+#include "pool.hpp"
+
+// A linked list that keeps several elements in each node, rather
+// than one.
+//
+// Walking a LinkedList costs a cache miss per element: each cell is
+// its own allocation, somewhere in memory, holding one element and
+// the overhead of a pointer (and, for LinkedList, a shared_ptr control
+// block).  Here a node is NodeBytes big (two cache lines by default)
+// and holds as many elements as fit, next to each other like an
+// array.  So a walk takes a miss per node rather than per element,
+// the hardware prefetcher can follow along inside a node, and the
+// per-element overhead is a pointer divided by the number of
+// elements in a node.
+//
+// The interface is LinkedList's.  Each node's elements are
+// items[lo, hi): append fills the tail node upward and prepend fills
+// the head node downward, so both are still O(1).  operator[] skips
+// whole nodes, so it is O(n / elements per node).
+template <class T, size_t NodeBytes = 128>
+class UnrolledLinkedList
+{
+    // The header is a pointer and two small counts.
+    static constexpr size_t header = sizeof(void *) + 2 * sizeof(uint32_t);
+
+public:
+    // How many elements fit in a node (at least one, however big T
+    // is).
+    static constexpr size_t per_node =
+        std::max<size_t>(1, NodeBytes > header ? (NodeBytes - header) / sizeof(T) : 0);
+
+private:
+    struct alignas(64) Node
+    {
+        Node *next = nullptr;
+        uint32_t lo = 0;
+        uint32_t hi = 0;
+        alignas(T) unsigned char storage[per_node * sizeof(T)];
+
+        T *items() { return std::launder(reinterpret_cast<T *>(storage)); }
+    };
+
+public:
+    template <bool Const>
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const, const T &, T &>;
+        using pointer = std::conditional_t<Const, const T *, T *>;
+
+        Iterator() {}
+        Iterator(Node *node, uint32_t at) : node(node), at(at) {}
+        operator Iterator<true>() const { return Iterator<true>(node, at); }
+
+        reference operator*() const { return node->items()[at]; }
+        pointer operator->() const { return &node->items()[at]; }
+        Iterator &operator++()
+        {
+            if (++at == node->hi)
+            {
+                node = node->next;
+                at = node ? node->lo : 0;
+            }
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            auto ret = *this;
+            ++*this;
+            return ret;
+        }
+        bool operator==(const Iterator &other) const
+        {
+            return node == other.node && at == other.at;
+        }
+
+    private:
+        Node *node = nullptr;
+        uint32_t at = 0;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    // For list_map: the same kind of list, of U.
+    template <class U>
+    using rebind = UnrolledLinkedList<U, NodeBytes>;
+
+    UnrolledLinkedList() {}
+
+    // Assignment is a deep copy, like LinkedList's.
+    UnrolledLinkedList(const UnrolledLinkedList &other)
+    {
+        for (const auto &data : other)
+            append(data);
+    }
+
+    UnrolledLinkedList &operator=(const UnrolledLinkedList &other)
+    {
+        if (&other == this)
+            return *this;
+        clear();
+        for (const auto &data : other)
+            append(data);
+        return *this;
+    }
+
+    UnrolledLinkedList(UnrolledLinkedList &&other) noexcept
+        : _pool(std::move(other._pool)),
+          _head(std::exchange(other._head, nullptr)),
+          _tail(std::exchange(other._tail, nullptr)),
+          _len(std::exchange(other._len, 0))
+    {
+    }
+
+    UnrolledLinkedList &operator=(UnrolledLinkedList &&other) noexcept
+    {
+        if (&other == this)
+            return *this;
+        clear();
+        _pool = std::move(other._pool);
+        _head = std::exchange(other._head, nullptr);
+        _tail = std::exchange(other._tail, nullptr);
+        _len = std::exchange(other._len, 0);
+        return *this;
+    }
+
+    ~UnrolledLinkedList() { clear(); }
+
+    size_t len() const { return _len; }
+
+    void append(const T &data)
+    {
+        if (!_tail || _tail->hi == per_node)
+        {
+            auto node = _pool.make();
+            if (_tail)
+                _tail->next = node;
+            else
+                _head = node;
+            _tail = node;
+        }
+        new (_tail->items() + _tail->hi) T(data);
+        _tail->hi++;
+        _len++;
+    }
+
+    void prepend(const T &data)
+    {
+        if (!_head || _head->lo == 0)
+        {
+            auto node = _pool.make();
+            node->lo = node->hi = (uint32_t)per_node;
+            node->next = _head;
+            _head = node;
+            if (!_tail)
+                _tail = node;
+        }
+        new (_head->items() + _head->lo - 1) T(data);
+        _head->lo--;
+        _len++;
+    }
+
+    T &operator[](size_t location)
+    {
+        for (auto node = _head; node; node = node->next)
+        {
+            auto count = node->hi - node->lo;
+            if (location < count)
+                return node->items()[node->lo + location];
+            location -= count;
+        }
+        throw SliceException("Index out of range");
+    }
+
+    void clear()
+    {
+        if constexpr (!std::is_trivially_destructible_v<T>)
+        {
+            for (auto node = _head; node; node = node->next)
+                std::destroy(node->items() + node->lo, node->items() + node->hi);
+        }
+        // Node itself is trivially destructible, so the pool can just
+        // forget them all.
+        _pool.reset();
+        _head = _tail = nullptr;
+        _len = 0;
+    }
+
+    iterator begin() { return _head ? iterator(_head, _head->lo) : iterator(); }
+    iterator end() { return iterator(); }
+    const_iterator begin() const { return _head ? const_iterator(_head, _head->lo) : const_iterator(); }
+    const_iterator end() const { return const_iterator(); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+private:
+    ObjectPool<Node> _pool;
+    Node *_head = nullptr;
+    Node *_tail = nullptr;
+    size_t _len = 0;
+};
+
+#endif
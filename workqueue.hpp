@@ -3,8 +3,96 @@
 
 #include <queue>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <thread>
+#include <exception>
+#include <functional>
+#include <array>
+#include <bit>
+#include <type_traits>
+#include <coroutine>
+#include <cassert>
 
-template <class T>
+// Thrown by the blocking put() and get() once the queue has been
+// closed.  get() only throws after everything already in the queue
+// has been handed out, so consumers can drain a closed queue.
+class WorkQueueClosedException : public std::exception
+{
+public:
+    virtual const char *what() const noexcept { return "WorkQueue is closed"; }
+};
+
+// How hard a blocked put() or get() tries before going to sleep on a
+// condition variable.  Sleeping costs a futex call on both sides and
+// a context switch, which for a quick hand-off is far more expensive
+// than just waiting a little while.  So we first spin (checking
+// without taking the lock), then yield the CPU a few times, and only
+// then actually park the thread.
+//
+// The default of no spinning and no yielding is the original
+// behavior: go straight to sleep.
+struct WaitStrategy
+{
+    size_t spins = 0;
+    size_t yields = 0;
+};
+
+// Tells the CPU we are in a spin loop.  On x86 this is the PAUSE
+// instruction, which keeps the spinning core from hogging the memory
+// system (and its hyperthread sibling).
+inline void workqueue_cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// What an instrumented WorkQueue has seen so far (see snapshot()).
+//
+// The wait histograms count how long a thread was asleep on the
+// condition variable each time it had to sleep: bucket i counts waits
+// of less than 2^i nanoseconds (and at least 2^(i-1)), with the last
+// bucket catching everything longer, so bucket 10 is roughly "under
+// a microsecond" and bucket 20 "under a millisecond".
+struct WorkQueueStats
+{
+    static constexpr size_t BUCKETS = 40;
+
+    uint64_t puts = 0;
+    uint64_t gets = 0;
+    size_t high_water = 0;
+
+    // Producers asleep on notify_put, i.e. the queue was full.
+    uint64_t put_waits = 0;
+    uint64_t put_wait_ns = 0;
+    std::array<uint64_t, BUCKETS> put_wait_histogram{};
+
+    // Consumers asleep on notify_get, i.e. the queue was empty.
+    uint64_t get_waits = 0;
+    uint64_t get_wait_ns = 0;
+    std::array<uint64_t, BUCKETS> get_wait_histogram{};
+
+    // How often we went for the lock and somebody else had it.
+    uint64_t lock_acquisitions = 0;
+    uint64_t contended_locks = 0;
+
+    static size_t bucket(uint64_t ns)
+    {
+        return std::min((size_t)std::bit_width(ns), BUCKETS - 1);
+    }
+};
+
+// Set Instrumented to have the queue keep a WorkQueueStats.  The
+// counters are updated while the lock is already held, so they don't
+// need to be atomic.  Without it every bit of the bookkeeping is
+// compiled out (it is all "if constexpr"), and the stats member takes
+// no space, so a plain WorkQueue<T> pays nothing.
+template <class T, bool Instrumented = false>
 class WorkQueue
 {
 private:
@@ -18,6 +106,13 @@ public:
         assert(size > 0);
     };
 
+    WorkQueue(WaitStrategy how) { strategy = how; }
+
+    WorkQueue(size_t size, WaitStrategy how) : WorkQueue(size)
+    {
+        strategy = how;
+    }
+
     // We define our WorkQueue as NOT being copyable or movable, as it has non-copyable
     // components in it, and it would be undefined behavior even to
     // move it with things waiting on the old condition variables.  To
@@ -27,59 +122,524 @@ public:
     WorkQueue(const WorkQueue &) = delete;
     void operator=(const WorkQueue &) = delete;
 
-    void put(T &element)
+    // Blocks until there is room.  Throws WorkQueueClosedException if
+    // the queue is (or becomes) closed.
+    void put(const T &element)
+    {
+        if (!put_internal(element, true, std::nullopt))
+            throw WorkQueueClosedException();
+    }
+
+    void put(T &&element)
+    {
+        if (!put_internal(std::move(element), true, std::nullopt))
+            throw WorkQueueClosedException();
+    }
+
+    // Never blocks.  Returns false if the queue is full or closed.
+    bool try_put(const T &element)
+    {
+        return put_internal(element, false, std::nullopt);
+    }
+
+    // Waits at most timeout for room.  Returns false on timeout or if
+    // the queue is closed.
+    template <class Rep, class Period>
+    bool put_for(const T &element, const std::chrono::duration<Rep, Period> &timeout)
+    {
+        return put_internal(element, true,
+                            std::chrono::steady_clock::now() + timeout);
+    }
+
+    // Blocks until there is data.  Throws WorkQueueClosedException
+    // if the queue is closed and empty.
+    T get()
+    {
+        auto ret = get_internal(true, std::nullopt);
+        if (!ret)
+            throw WorkQueueClosedException();
+        return std::move(*ret);
+    }
+
+    // Never blocks.  Returns nothing if the queue is empty.
+    std::optional<T> try_get()
+    {
+        return get_internal(false, std::nullopt);
+    }
+
+    // Waits at most timeout for data.
+    template <class Rep, class Period>
+    std::optional<T> get_for(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        return get_internal(true, std::chrono::steady_clock::now() + timeout);
+    }
+
+    // The coroutine versions of put() and get().  Rather than blocking
+    // the thread they suspend the coroutine, which is resumed when the
+    // put or get can go through.  So
+    //
+    //    auto x = co_await queue.async_get();
+    //    co_await queue.async_put(x);
+    //
+    // and thousands of coroutines can wait on queues while only a
+    // handful of threads exist.  They throw WorkQueueClosedException
+    // just like put() and get(), and freely mix with threads using the
+    // blocking calls on the same queue.
+    //
+    // A suspended coroutine gets resumed by whichever thread made
+    // progress possible, by handing its handle to the executor (see
+    // set_executor).  The awaiter objects live in the coroutine frame,
+    // so nothing is allocated.
+    class GetAwaiter;
+    class PutAwaiter;
+
+    GetAwaiter async_get() { return GetAwaiter(*this); }
+    PutAwaiter async_put(T element) { return PutAwaiter(*this, std::move(element)); }
+
+    // By default a coroutine is resumed right away on the thread that
+    // woke it, inside its put() or get() call.  That is cheap, but means
+    // a producer ends up running the consumer.  Usually you want to
+    // hand it to a thread pool instead, e.g. ThreadPool::executor().
+    // Must be set before any coroutine waits on the queue.
+    void set_executor(std::function<void(std::coroutine_handle<>)> how)
+    {
+        executor = std::move(how);
+    }
+
+    // Closing wakes up everybody who is waiting.  Waiting producers
+    // fail, waiting consumers get whatever is left and then fail.
+    void close()
+    {
+        AsyncWaiter *getters, *putters;
+        {
+            auto l = acquire();
+            closed = true;
+            getters = async_getters.take_all();
+            putters = async_putters.take_all();
+        }
+        notify_get.notify_all();
+        notify_put.notify_all();
+        resume_all(getters);
+        resume_all(putters);
+    }
+
+    bool is_closed() const { return closed; }
+
+    // A copy of the statistics so far.  This takes the lock, so it is
+    // cheap but not free: don't call it in a tight loop.
+    WorkQueueStats snapshot()
+        requires Instrumented
+    {
+        std::unique_lock l(lock);
+        return stats;
+    }
+
+    // Only a snapshot: it can be stale by the time you look at it.
+    size_t size() const { return count.load(std::memory_order_relaxed); }
+
+private:
+    using Deadline = std::optional<std::chrono::steady_clock::time_point>;
+
+    // A suspended coroutine, waiting in a FIFO list.  The list is
+    // intrusive (the link is in the awaiter) since the awaiter already
+    // lives in the coroutine frame.
+    struct AsyncWaiter
+    {
+        std::coroutine_handle<> handle;
+        AsyncWaiter *next = nullptr;
+    };
+
+    struct AsyncWaiterList
+    {
+        AsyncWaiter *head = nullptr;
+        AsyncWaiter *tail = nullptr;
+
+        void push(AsyncWaiter *w)
+        {
+            w->next = nullptr;
+            if (tail)
+                tail->next = w;
+            else
+                head = w;
+            tail = w;
+        }
+        AsyncWaiter *pop()
+        {
+            auto ret = head;
+            if (ret)
+            {
+                head = ret->next;
+                if (!head)
+                    tail = nullptr;
+            }
+            return ret;
+        }
+        AsyncWaiter *take_all()
+        {
+            auto ret = head;
+            head = tail = nullptr;
+            return ret;
+        }
+    };
+
+    void resume(AsyncWaiter *w)
+    {
+        if (executor)
+            executor(w->handle);
+        else
+            w->handle.resume();
+    }
+
+    void resume_all(AsyncWaiter *w)
+    {
+        while (w)
+        {
+            // Grab the next one first: once resumed the coroutine
+            // can finish and the awaiter is gone.
+            auto next = w->next;
+            resume(w);
+            w = next;
+        }
+    }
+
+    // These are only hints for spinning, the real check is always
+    // done again while holding the lock.
+    bool can_put() const
+    {
+        return closed || capacity == 0 ||
+               count.load(std::memory_order_relaxed) < capacity;
+    }
+
+    bool can_get() const
+    {
+        return closed || count.load(std::memory_order_relaxed) > 0;
+    }
+
+    template <class Ready>
+    void spin_until(Ready ready)
+    {
+        for (size_t i = 0; i < strategy.spins; ++i)
+        {
+            if (ready())
+                return;
+            workqueue_cpu_relax();
+        }
+        for (size_t i = 0; i < strategy.yields; ++i)
+        {
+            if (ready())
+                return;
+            std::this_thread::yield();
+        }
+    }
+
+    // Instrumented, we first try_lock just so we can tell if somebody
+    // else had it.
+    std::unique_lock<std::mutex> acquire()
+    {
+        if constexpr (Instrumented)
+        {
+            std::unique_lock l(lock, std::try_to_lock);
+            if (!l.owns_lock())
+            {
+                l.lock();
+                stats.contended_locks++;
+            }
+            stats.lock_acquisitions++;
+            return l;
+        }
+        else
+        {
+            return std::unique_lock(lock);
+        }
+    }
+
+    // Waits on the condition variable, returning false if the deadline
+    // passed.  With no deadline we wait forever.
+    bool park(std::unique_lock<std::mutex> &l, std::condition_variable &cv,
+              size_t &waiters, const Deadline &deadline)
+    {
+        bool ok = true;
+        std::chrono::steady_clock::time_point start;
+        if constexpr (Instrumented)
+            start = std::chrono::steady_clock::now();
+        waiters++;
+        if (deadline)
+            ok = cv.wait_until(l, *deadline) == std::cv_status::no_timeout;
+        else
+            cv.wait(l);
+        waiters--;
+        if constexpr (Instrumented)
+        {
+            // We have the lock again, so can update stats.
+            auto ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+            if (&cv == &notify_put)
+            {
+                stats.put_waits++;
+                stats.put_wait_ns += ns;
+                stats.put_wait_histogram[WorkQueueStats::bucket(ns)]++;
+            }
+            else
+            {
+                stats.get_waits++;
+                stats.get_wait_ns += ns;
+                stats.get_wait_histogram[WorkQueueStats::bucket(ns)]++;
+            }
+        }
+        return ok;
+    }
+
+    // Must hold the lock.
+    void count_put()
+    {
+        if constexpr (Instrumented)
+        {
+            stats.puts++;
+            stats.high_water = std::max(stats.high_water, data.size());
+        }
+    }
+
+    void count_get()
+    {
+        if constexpr (Instrumented)
+            stats.gets++;
+    }
+
+    template <class U>
+    bool put_internal(U &&element, bool block, const Deadline &deadline)
     {
         // This convention is so that we don't cause a
         // "wake up and lock again" immediately on the other
         // thread.  Instead we see if we will need to
         // notify and if so, notify AFTER we release the lock.
-        bool wasempty = false;
+        // We only notify if somebody is actually asleep, as
+        // a consumer that is still spinning will see the data
+        // on its own.
+        bool wake = false;
+        AsyncWaiter *waiter = nullptr;
+        if (block)
+            spin_until([this]()
+                       { return can_put(); });
         {
-            std::unique_lock l(lock);
+            auto l = acquire();
+            bool timed_out = false;
             // If there are already more elements than capacity
             // we wait.  Note that capacity 0 is special so...
-            while (capacity != 0 &&
+            while (!closed && capacity != 0 &&
                    data.size() >= capacity)
             {
-                notify_put.wait(l);
+                if (!block || timed_out)
+                    return false;
+                timed_out = !park(l, notify_put, put_waiters, deadline);
             }
-            wasempty = data.empty();
-            data.push(element);
+            if (closed)
+                return false;
+            waiter = push_locked(std::forward<U>(element), wake);
         }
-        if (wasempty)
+        if (wake)
             notify_get.notify_one();
+        if (waiter)
+            resume(waiter);
+        return true;
     }
 
-    T get()
+    // Must hold the lock, and there must be room.  If a coroutine is
+    // waiting for data the element goes straight to it, and we return
+    // it for resuming once the lock is released.  Otherwise sets wake
+    // if a thread needs notifying.
+    template <class U>
+    AsyncWaiter *push_locked(U &&element, bool &wake)
     {
-        bool wasfull = false;
-        std::unique_lock l(lock);
-        while (data.empty())
+        auto waiter = static_cast<GetAwaiter *>(async_getters.pop());
+        if (waiter)
+        {
+            waiter->result.emplace(std::forward<U>(element));
+            count_put();
+            count_get();
+            return waiter;
+        }
+        data.push(std::forward<U>(element));
+        count_put();
+        count.store(data.size(), std::memory_order_relaxed);
+        wake = get_waiters > 0;
+        return nullptr;
+    }
+
+    // Must hold the lock, and there must be data.  The room this
+    // makes goes to a waiting coroutine first, if there is one.
+    T pop_locked(AsyncWaiter *&waiter, bool &wake)
+    {
+        T ret(std::move(data.front()));
+        data.pop();
+        count_get();
+        auto putter = static_cast<PutAwaiter *>(async_putters.pop());
+        if (putter)
         {
-            notify_get.wait(l);
+            data.push(std::move(putter->value));
+            count_put();
+            putter->ok = true;
+            waiter = putter;
         }
-        if (data.size() >= capacity)
+        count.store(data.size(), std::memory_order_relaxed);
+        wake = put_waiters > 0;
+        return ret;
+    }
+
+    std::optional<T> get_internal(bool block, const Deadline &deadline)
+    {
+        bool wake = false;
+        AsyncWaiter *waiter = nullptr;
+        if (block)
+            spin_until([this]()
+                       { return can_get(); });
+        auto l = acquire();
+        bool timed_out = false;
+        while (data.empty())
         {
-            wasfull = true;
+            if (closed || !block || timed_out)
+                return std::nullopt;
+            timed_out = !park(l, notify_get, get_waiters, deadline);
         }
-        auto ret = data.front();
-        data.pop();
+        std::optional<T> ret(pop_locked(waiter, wake));
         // Doing an explicit unlock rather than RAII unlock because
         // of scoping issues with ret.
         l.unlock();
-        if (wasfull)
+        if (wake)
         {
             notify_put.notify_one();
         }
+        if (waiter)
+            resume(waiter);
         return ret;
     }
 
+public:
+    class GetAwaiter : AsyncWaiter
+    {
+    public:
+        // The fast path: if there is data we never suspend at all.
+        bool await_ready()
+        {
+            result = queue.try_get();
+            return result.has_value();
+        }
+
+        // Returning false means "don't suspend after all", which is
+        // what we do if data showed up (or the queue closed) since
+        // await_ready looked.
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            this->handle = h;
+            bool wake = false;
+            AsyncWaiter *waiter = nullptr;
+            {
+                auto l = queue.acquire();
+                if (queue.data.empty())
+                {
+                    if (queue.closed)
+                        return false;
+                    queue.async_getters.push(this);
+                    return true;
+                }
+                result.emplace(queue.pop_locked(waiter, wake));
+            }
+            if (wake)
+                queue.notify_put.notify_one();
+            if (waiter)
+                queue.resume(waiter);
+            return false;
+        }
+
+        T await_resume()
+        {
+            if (!result)
+                throw WorkQueueClosedException();
+            return std::move(*result);
+        }
+
+    private:
+        friend WorkQueue;
+        GetAwaiter(WorkQueue &q) : queue(q) {}
+        WorkQueue &queue;
+        std::optional<T> result;
+    };
+
+    class PutAwaiter : AsyncWaiter
+    {
+    public:
+        bool await_ready()
+        {
+            ok = queue.put_internal(std::move(value), false, std::nullopt);
+            return ok;
+        }
+
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            this->handle = h;
+            bool wake = false;
+            AsyncWaiter *waiter = nullptr;
+            {
+                auto l = queue.acquire();
+                if (queue.closed)
+                    return false;
+                if (queue.capacity != 0 && queue.data.size() >= queue.capacity)
+                {
+                    queue.async_putters.push(this);
+                    return true;
+                }
+                waiter = queue.push_locked(std::move(value), wake);
+                ok = true;
+            }
+            if (wake)
+                queue.notify_get.notify_one();
+            if (waiter)
+                queue.resume(waiter);
+            return false;
+        }
+
+        void await_resume()
+        {
+            if (!ok)
+                throw WorkQueueClosedException();
+        }
+
+    private:
+        friend WorkQueue;
+        PutAwaiter(WorkQueue &q, T element) : queue(q), value(std::move(element)) {}
+        WorkQueue &queue;
+        T value;
+        bool ok = false;
+    };
+
 private:
+
     std::queue<T> data;
     std::mutex lock;
     std::condition_variable notify_get;
     std::condition_variable notify_put;
     size_t capacity = 0;
+    WaitStrategy strategy;
+
+    // How many threads are asleep on each condition variable.
+    // Protected by lock.
+    size_t get_waiters = 0;
+    size_t put_waiters = 0;
+
+    // Mirrors data.size() and the closed flag so spinners can
+    // look without taking the lock.
+    std::atomic<size_t> count = 0;
+    std::atomic<bool> closed = false;
+
+    // Suspended coroutines.  Protected by lock.
+    AsyncWaiterList async_getters;
+    AsyncWaiterList async_putters;
+    std::function<void(std::coroutine_handle<>)> executor;
+
+    struct NoStats
+    {
+    };
+    [[no_unique_address]] std::conditional_t<Instrumented, WorkQueueStats, NoStats> stats;
 };
 
-#endif
\ No newline at end of file
+#endif
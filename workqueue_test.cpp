@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <string>
 #include "workqueue.hpp"
+#include "threadpool.hpp"
 #include <thread>
 #include <ranges>
 #include <cstdlib>
@@ -73,3 +74,212 @@ TEST(WorkQueue, LittleCapacity)
 }
 
 
+TEST(WorkQueue, SpinThenPark)
+{
+    for (auto y : std::views::iota(0, 5))
+    {
+        WorkQueue<int> w(4, WaitStrategy{1000, 10});
+
+        std::jthread j([&]()
+                       {
+                        for (auto i : std::views::iota(0, 1000))
+                        {
+                            EXPECT_EQ(w.get(), i);
+                        } });
+        (void)y;
+        for (auto i : std::views::iota(0, 1000))
+        {
+            w.put(i);
+        }
+    }
+}
+
+TEST(WorkQueue, TryOperations)
+{
+    WorkQueue<int> w(2);
+    EXPECT_FALSE(w.try_get());
+    EXPECT_TRUE(w.try_put(1));
+    EXPECT_TRUE(w.try_put(2));
+    EXPECT_FALSE(w.try_put(3));
+    EXPECT_EQ(w.size(), 2);
+    EXPECT_EQ(w.try_get(), 1);
+    EXPECT_EQ(w.try_get(), 2);
+    EXPECT_FALSE(w.try_get());
+}
+
+TEST(WorkQueue, TimedOperations)
+{
+    using namespace std::chrono_literals;
+    WorkQueue<int> w(1);
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(w.get_for(20ms));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 20ms);
+
+    EXPECT_TRUE(w.put_for(1, 20ms));
+    start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(w.put_for(2, 20ms));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 20ms);
+
+    std::jthread j([&]()
+                   {
+                    std::this_thread::sleep_for(10ms);
+                    w.put(3); });
+    EXPECT_EQ(w.get_for(1s), 1);
+    EXPECT_EQ(w.get_for(1s), 3);
+}
+
+TEST(WorkQueue, CloseWakesWaiters)
+{
+    using namespace std::chrono_literals;
+    WorkQueue<int> w(1);
+    std::atomic<int> woken = 0;
+    {
+        std::vector<std::jthread> consumers;
+        for (auto i : std::views::iota(0, 4))
+        {
+            (void)i;
+            consumers.emplace_back([&]()
+                                   {
+                                    EXPECT_THROW(w.get(), WorkQueueClosedException);
+                                    woken++; });
+        }
+        std::this_thread::sleep_for(10ms);
+        w.close();
+    }
+    EXPECT_EQ(woken, 4);
+    EXPECT_THROW(w.put(1), WorkQueueClosedException);
+    EXPECT_FALSE(w.try_put(1));
+
+    // Whatever was queued before the close can still be drained.
+    WorkQueue<int> v;
+    v.put(1);
+    v.put(2);
+    v.close();
+    EXPECT_EQ(v.get(), 1);
+    EXPECT_EQ(v.try_get(), 2);
+    EXPECT_THROW(v.get(), WorkQueueClosedException);
+}
+
+// Consumers are coroutines.  The queue resumes them on a pool with
+// a couple of threads, far fewer than there are consumers.
+DetachedCoroutine async_consumer(WorkQueue<int> &in, WorkQueue<int> &out,
+                                 ThreadPool &pool, std::atomic<int> &finished)
+{
+    co_await pool.schedule();
+    try
+    {
+        while (true)
+        {
+            auto x = co_await in.async_get();
+            co_await out.async_put(x * 2);
+        }
+    }
+    catch (WorkQueueClosedException &)
+    {
+    }
+    finished++;
+}
+
+TEST(WorkQueue, AsyncGetAndPut)
+{
+    const int consumers = 1000;
+    const int items = 10000;
+    ThreadPool pool(2);
+    WorkQueue<int> in(16);
+    WorkQueue<int> out(16);
+    in.set_executor(pool.executor());
+    out.set_executor(pool.executor());
+    std::atomic<int> finished = 0;
+    for (auto i : std::views::iota(0, consumers))
+    {
+        (void)i;
+        async_consumer(in, out, pool, finished);
+    }
+    long total = 0;
+    std::jthread producer([&]()
+                          {
+                            for (auto i : std::views::iota(0, items))
+                            {
+                                in.put(i);
+                            }
+                            in.close(); });
+    for (auto i : std::views::iota(0, items))
+    {
+        (void)i;
+        total += out.get();
+    }
+    EXPECT_EQ(total, 2L * items * (items - 1) / 2);
+    while (finished < consumers)
+    {
+        std::this_thread::yield();
+    }
+}
+
+DetachedCoroutine async_closed(WorkQueue<int> &q, std::atomic<int> &threw)
+{
+    try
+    {
+        co_await q.async_get();
+    }
+    catch (WorkQueueClosedException &)
+    {
+        threw++;
+    }
+    try
+    {
+        co_await q.async_put(1);
+    }
+    catch (WorkQueueClosedException &)
+    {
+        threw++;
+    }
+}
+
+TEST(WorkQueue, AsyncClose)
+{
+    // No executor, so the coroutine resumes inside close().
+    WorkQueue<int> q(1);
+    std::atomic<int> threw = 0;
+    async_closed(q, threw);
+    EXPECT_EQ(threw, 0);
+    q.close();
+    EXPECT_EQ(threw, 2);
+}
+
+TEST(WorkQueue, Instrumented)
+{
+    using namespace std::chrono_literals;
+    // The uninstrumented queue doesn't even carry the counters.
+    static_assert(sizeof(WorkQueue<int>) + sizeof(WorkQueueStats) <= sizeof(WorkQueue<int, true>));
+
+    WorkQueue<int, true> w(2);
+    w.put(1);
+    w.put(2);
+    EXPECT_FALSE(w.try_put(3));
+    std::jthread j([&]()
+                   {
+                    std::this_thread::sleep_for(20ms);
+                    w.get();
+                    w.get();
+                    w.get(); });
+    // Full, so this has to wait for the consumer.
+    w.put(3);
+    j.join();
+
+    auto stats = w.snapshot();
+    EXPECT_EQ(stats.puts, 3);
+    EXPECT_EQ(stats.gets, 3);
+    EXPECT_EQ(stats.high_water, 2);
+    EXPECT_EQ(stats.put_waits, 1);
+    EXPECT_GE(stats.put_wait_ns, 10'000'000);
+    uint64_t in_histogram = 0;
+    for (auto c : stats.put_wait_histogram)
+    {
+        in_histogram += c;
+    }
+    EXPECT_EQ(in_histogram, 1);
+    // About 20ms is bucket 25 (2^25 ns is 33ms).
+    EXPECT_EQ(stats.put_wait_histogram[WorkQueueStats::bucket(stats.put_wait_ns)], 1);
+    EXPECT_GE(stats.lock_acquisitions, 7);
+    EXPECT_LE(stats.contended_locks, stats.lock_acquisitions);
+}